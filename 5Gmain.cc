@@ -1,21 +1,53 @@
 // Include statements
-#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "ns3/antenna-module.h"
 #include "ns3/random-variable-stream.h"
 // #include "lte-ue-phy.h"
 #include "ns3/config-store.h"
 #include "ns3/core-module.h"
 #include "ns3/eps-bearer-tag.h"
+#include "ns3/calendar-scheduler.h"
 #include "ns3/grid-scenario-helper.h"
+#include "ns3/heap-scheduler.h"
+#include "ns3/list-scheduler.h"
 #include "ns3/mobility-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/log.h"
+#include "ns3/lte-enb-rrc.h"
+#include "ns3/lte-pdcp.h"
+#include "ns3/lte-rlc.h"
+#include "ns3/lte-ue-rrc.h"
+#include "ns3/map-scheduler.h"
 #include "ns3/mobility-module.h"
 #include "ns3/network-module.h"
 #include "ns3/nr-helper.h"
 #include "ns3/nr-module.h"
 #include "ns3/nr-point-to-point-epc-helper.h"
+#include "async-trace-log.h"
+#include "cached-propagation-loss-model.h"
+#include "completion-monitor.h"
+#include "interference-radius-loss-model.h"
+#include "link-budget.h"
+#include "memory-report.h"
+#include "online-stats.h"
+#include "philox-rng.h"
+#include "position-sampler.h"
+#include "profiling-scheduler.h"
+#include "replication-result.h"
+#include "slot-calendar-scheduler.h"
+#include "spatial-grid.h"
+#include "spectral-efficiency.h"
+#include "telemetry-shm.h"
+#include "trace-record.h"
+#include "traffic-engine.h"
 
 using namespace ns3;
 
@@ -41,6 +73,63 @@ NS_LOG_COMPONENT_DEFINE ("5gMmWaveSimulation");
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 static bool g_rxPdcpCallbackCalled = false;
 static bool g_rxRxRlcPDUCallbackCalled = false;
+static ReplicationResult g_result; ///< measurements of the replication being run
+static TraceFileWriter g_traceWriter; ///< binary trace output, used instead of text when open
+static AsyncTraceLog g_asyncLog; ///< background trace output, if --asyncTrace is set
+static bool g_asyncTraceEnabled = false;
+static CompletionMonitor g_completion; ///< early stop, if --stopOn is set
+static TrafficEngine g_traffic; ///< flows of every UE, if --traffic is set
+static TelemetryWriter g_telemetry; ///< live progress counters, if --telemetry is set
+
+/**
+ * Output one trace event of the running replication: queued for the
+ * background writer with --asyncTrace, otherwise appended to the binary
+ * trace if one is open, or else printed as text.
+ * @param type Kind of event (TraceRecordType)
+ * @param cellId Cell id, 0 if unknown
+ * @param rnti RNTI, 0 if unknown
+ * @param bwpId BWP id or logical channel id
+ * @param aux Type dependent integer
+ * @param v0 First type dependent value
+ * @param v1 Second type dependent value
+ * @param v2 Third type dependent value
+ */
+static void
+WriteTraceRecord(uint16_t type,
+                 uint16_t cellId,
+                 uint16_t rnti,
+                 uint16_t bwpId,
+                 uint32_t aux,
+                 double v0,
+                 double v1 = 0.0,
+                 double v2 = 0.0)
+{
+    g_telemetry.CountCallback(type);
+    TraceRecord record;
+    record.timeNs = Simulator::Now().GetNanoSeconds();
+    record.run = static_cast<uint32_t>(g_result.run);
+    record.type = type;
+    record.cellId = cellId;
+    record.rnti = rnti;
+    record.bwpId = bwpId;
+    record.aux = aux;
+    record.value[0] = v0;
+    record.value[1] = v1;
+    record.value[2] = v2;
+    if (g_asyncLog.IsRunning())
+    {
+        g_asyncLog.Push(record);
+    }
+    else if (g_traceWriter.IsOpen())
+    {
+        g_traceWriter.Append(record);
+    }
+    else
+    {
+        char line[512];
+        fwrite(line, 1, FormatTraceRecordText(record, line, sizeof(line)), stdout);
+    }
+}
 
 /**
  * Function creates a single packet and directly calls the function send
@@ -61,68 +150,160 @@ SendPacket(Ptr<NetDevice> device, Address& addr, uint32_t packetSize)
     device->Send(pkt, addr, Ipv4L3Protocol::PROT_NUMBER);
 }
 
+/// Slots of its share of the cell a full-buffer flow keeps in flight,
+/// enough to cover the scheduling and HARQ delay
+static const uint32_t TRAFFIC_BACKLOG_SLOTS = 8;
+
+/// Delay after which a packet of a full-buffer flow that was not received
+/// is taken as lost, well beyond the HARQ retransmissions [ms]
+static const uint32_t TRAFFIC_LOSS_TIMEOUT_MS = 100;
+
+/// Print the TRAFFIC lines of the replication, see TrafficEngine::Report
+static void
+ReportTraffic()
+{
+    g_traffic.Report(std::cout, RngSeedManager::GetRun());
+}
+
 /**
  * Function that prints out PDCP delay. This function is designed as a callback
  * for PDCP trace source.
- * @param path The path that matches the trace source
+ * @param cellId Cell id bound at connect time
  * @param rnti RNTI of UE
  * @param lcid logical channel id
  * @param bytes PDCP PDU size in bytes
  * @param pdcpDelay PDCP delay
  */
 void
-RxPdcpPDU(std::string path, uint16_t rnti, uint8_t lcid, uint32_t bytes, uint64_t pdcpDelay)
+RxPdcpPDU(uint16_t cellId, uint16_t rnti, uint8_t lcid, uint32_t bytes, uint64_t pdcpDelay)
 {
-    std::cout << "\n Packet PDCP delay:" << pdcpDelay << "\n";
+    WriteTraceRecord(TRACE_PDCP_RX, cellId, rnti, lcid, bytes, static_cast<double>(pdcpDelay));
+    g_traffic.NotifyRx(cellId, rnti, bytes, pdcpDelay);
     g_rxPdcpCallbackCalled = true;
+    g_completion.Notify(CompletionMonitor::PDCP);
 }
 
 /**
  * Function that prints out RLC statistics, such as RNTI, lcId, RLC PDU size,
  * delay. This function is designed as a callback
  * for RLC trace source.
- * @param path The path that matches the trace source
+ * @param cellId Cell id bound at connect time
  * @param rnti RNTI of UE
  * @param lcid logical channel id
  * @param bytes RLC PDU size in bytes
  * @param rlcDelay RLC PDU delay
  */
 void
-RxRlcPDU(std::string path, uint16_t rnti, uint8_t lcid, uint32_t bytes, uint64_t rlcDelay)
+RxRlcPDU(uint16_t cellId, uint16_t rnti, uint8_t lcid, uint32_t bytes, uint64_t rlcDelay)
 {
-    std::cout << "\n\n Data received at RLC layer at:" << Simulator::Now() << std::endl;
-    std::cout << "\n rnti:" << rnti << std::endl;
-    std::cout << "\n lcid:" << (unsigned)lcid << std::endl;
-    std::cout << "\n bytes :" << bytes << std::endl;
-    std::cout << "\n delay :" << rlcDelay << std::endl;
+    WriteTraceRecord(TRACE_RLC_RX, cellId, rnti, lcid, bytes, static_cast<double>(rlcDelay));
     g_rxRxRlcPDUCallbackCalled = true;
+    g_completion.Notify(CompletionMonitor::RLC);
 }
 
 /**
- * Function that connects PDCP and RLC traces to the corresponding trace sources.
+ * Function that connects the PDCP and RLC RxPDU traces of one data radio
+ * bearer. The bearer map is owned by either LteUeRrc (DL) or UeManager (UL);
+ * both expose it as the DataRadioBearerMap attribute.
+ * @param rrc The LteUeRrc or UeManager owning the bearer
+ * @param cellId Cell id, bound into the callbacks
+ * @param lcid Logical channel id of the bearer to connect
  */
 void
-ConnectPdcpRlcTraces()
+BindDrbTraces(Ptr<Object> rrc, uint16_t cellId, uint8_t lcid)
 {
-    Config::Connect("/NodeList/*/DeviceList/*/LteUeRrc/DataRadioBearerMap/1/LtePdcp/RxPDU",
-                    MakeCallback(&RxPdcpPDU));
+    ObjectMapValue drbMap;
+    rrc->GetAttribute("DataRadioBearerMap", drbMap);
+    for (auto it = drbMap.Begin(); it != drbMap.End(); ++it)
+    {
+        UintegerValue drbLcid;
+        it->second->GetAttribute("logicalChannelIdentity", drbLcid);
+        if (drbLcid.Get() != lcid)
+        {
+            continue;
+        }
+        PointerValue pdcp;
+        PointerValue rlc;
+        it->second->GetAttribute("LtePdcp", pdcp);
+        it->second->GetAttribute("LteRlc", rlc);
+        pdcp.Get<LtePdcp>()->TraceConnectWithoutContext("RxPDU",
+                                                        MakeBoundCallback(&RxPdcpPDU, cellId));
+        rlc.Get<LteRlc>()->TraceConnectWithoutContext("RxPDU", MakeBoundCallback(&RxRlcPDU, cellId));
+    }
+}
 
-    Config::Connect("/NodeList/*/DeviceList/*/LteUeRrc/DataRadioBearerMap/1/LteRlc/RxPDU",
-                    MakeCallback(&RxRlcPDU));
+/**
+ * Function called when a DRB has been created, on either side. The bearer is
+ * connected in a separate event, after the RRC has finished setting it up.
+ * @param rrc The LteUeRrc or UeManager owning the bearer (bound)
+ * @param imsi IMSI of the UE
+ * @param cellId Cell id
+ * @param rnti RNTI of the UE
+ * @param lcid Logical channel id of the new bearer
+ */
+void
+DrbCreated(Ptr<Object> rrc, uint64_t imsi, uint16_t cellId, uint16_t rnti, uint8_t lcid)
+{
+    Simulator::ScheduleNow(&BindDrbTraces, rrc, cellId, lcid);
+}
+
+/**
+ * Function that connects the DL PDCP and RLC traces of the UEs. The bearers
+ * only exist once the UEs are connected, so this hooks the DrbCreated trace
+ * of each UE RRC, which binds every bearer as soon as it is set up.
+ * @param ueNetDev The UE devices
+ */
+void
+BindPdcpRlcTraces(const NetDeviceContainer& ueNetDev)
+{
+    for (auto it = ueNetDev.Begin(); it != ueNetDev.End(); ++it)
+    {
+        Ptr<LteUeRrc> rrc = DynamicCast<NrUeNetDevice>(*it)->GetRrc();
+        rrc->TraceConnectWithoutContext("DrbCreated",
+                                        MakeBoundCallback(&DrbCreated, Ptr<Object>(rrc)));
+    }
 }
 
+/**
+ * Function that hooks the DrbCreated trace of a new UE context at the gNB.
+ * @param rrc The gNB RRC (bound)
+ * @param cellId Cell id
+ * @param rnti RNTI of the new UE context
+ */
+void
+BindUeManagerTraces(Ptr<LteEnbRrc> rrc, uint16_t cellId, uint16_t rnti)
+{
+    Ptr<UeManager> ueManager = rrc->GetUeManager(rnti);
+    ueManager->TraceConnectWithoutContext("DrbCreated",
+                                          MakeBoundCallback(&DrbCreated, Ptr<Object>(ueManager)));
+}
 
 /**
- * Function that connects UL PDCP and RLC traces to the corresponding trace sources.
+ * Function called when the gNB RRC creates a UE context.
+ * @param rrc The gNB RRC (bound)
+ * @param cellId Cell id
+ * @param rnti RNTI of the new UE context
  */
 void
-ConnectUlPdcpRlcTraces()
+NewUeContext(Ptr<LteEnbRrc> rrc, uint16_t cellId, uint16_t rnti)
 {
-    Config::Connect("/NodeList/*/DeviceList/*/LteEnbRrc/UeMap/*/DataRadioBearerMap/*/LtePdcp/RxPDU",
-                    MakeCallback(&RxPdcpPDU));
+    Simulator::ScheduleNow(&BindUeManagerTraces, rrc, cellId, rnti);
+}
 
-    Config::Connect("/NodeList/*/DeviceList/*/LteEnbRrc/UeMap/*/DataRadioBearerMap/*/LteRlc/RxPDU",
-                    MakeCallback(&RxRlcPDU));
+/**
+ * Function that connects the UL PDCP and RLC traces at the gNBs, through the
+ * NewUeContext trace of each gNB RRC and then the DrbCreated trace of each
+ * UE context.
+ * @param enbNetDev The gNB devices
+ */
+void
+BindUlPdcpRlcTraces(const NetDeviceContainer& enbNetDev)
+{
+    for (auto it = enbNetDev.Begin(); it != enbNetDev.End(); ++it)
+    {
+        Ptr<LteEnbRrc> rrc = DynamicCast<NrGnbNetDevice>(*it)->GetRrc();
+        rrc->TraceConnectWithoutContext("NewUeContext", MakeBoundCallback(&NewUeContext, rrc));
+    }
 }
 
 
@@ -130,26 +311,133 @@ ConnectUlPdcpRlcTraces()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////// adding for getting RSRP and SE value ///////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Streaming distributions of the DL SINR, RSSI and spectral efficiency of
+ * one (cell, RNTI, BWP).
+ */
+struct LinkStats
+{
+    StreamSummary sinrDb; ///< DL data SINR [dB]
+    StreamSummary rssi;   ///< RSSI per processed chunk [dBm]
+    StreamSummary se;     ///< spectral efficiency [bps/Hz]
+};
+
+static bool g_linkStatsEnabled = false;
+/// Per-link statistics, keyed by cellId << 32 | rnti << 16 | bwpId
+static std::unordered_map<uint64_t, LinkStats> g_linkStats;
+
+static LinkStats&
+GetLinkStats(uint16_t cellId, uint16_t rnti, uint16_t bwpId)
+{
+    uint64_t key = (static_cast<uint64_t>(cellId) << 32) | (static_cast<uint64_t>(rnti) << 16) | bwpId;
+    return g_linkStats[key];
+}
+
+/**
+ * Print one "STATS" line per link and metric, then reset the statistics.
+ * Scheduled with Simulator::ScheduleDestroy, so it runs once per replication.
+ */
+static void
+DumpLinkStats()
+{
+    std::vector<uint64_t> keys;
+    keys.reserve(g_linkStats.size());
+    for (const auto& entry : g_linkStats)
+    {
+        keys.push_back(entry.first);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    for (uint64_t key : keys)
+    {
+        const LinkStats& stats = g_linkStats[key];
+        const std::pair<const char*, const StreamSummary*> metrics[] = {{"sinrDb", &stats.sinrDb},
+                                                                        {"rssiDbm", &stats.rssi},
+                                                                        {"se", &stats.se}};
+        for (const auto& metric : metrics)
+        {
+            const StreamSummary& summary = *metric.second;
+            if (summary.Stats().Count() == 0)
+            {
+                continue;
+            }
+            printf("STATS run=%llu cell=%u rnti=%u bwp=%u metric=%s n=%llu mean=%f std=%f min=%f "
+                   "max=%f p50=%f p90=%f p99=%f\n",
+                   static_cast<unsigned long long>(g_result.run),
+                   static_cast<unsigned>(key >> 32),
+                   static_cast<unsigned>((key >> 16) & 0xffff),
+                   static_cast<unsigned>(key & 0xffff),
+                   metric.first,
+                   static_cast<unsigned long long>(summary.Stats().Count()),
+                   summary.Stats().Mean(),
+                   summary.Stats().StdDev(),
+                   summary.Stats().Min(),
+                   summary.Stats().Max(),
+                   summary.P50(),
+                   summary.P90(),
+                   summary.P99());
+        }
+    }
+    g_linkStats.clear();
+}
+
+/// SINR to SE mapping, see spectral-efficiency.h
+static SeMode g_seMode = SeMode::SHANNON;
+
+/// With --partitions or --measureUe0, only UE 0 of the whole scenario fills
+/// g_result; its PHY, or null in the partitions that do not have it
+static bool g_measureOneUe = false;
+static Ptr<NrUePhy> g_measuredUePhy;
+static bool g_measuredUeBuilt = false; ///< whether the last built scenario had UE 0
+
+/// \return true if the measurements of this UE go to g_result
+static bool
+IsMeasuredUe(uint16_t cellId, uint16_t rnti)
+{
+    return !g_measureOneUe || (g_measuredUePhy && g_measuredUePhy->GetCellId() == cellId &&
+                               g_measuredUePhy->GetRnti() == rnti);
+}
+
 double CalculateSpectralEfficiency(double sinr) {
-    // Shannon's formula to estimate spectral efficiency
-    // This is a simplification and might not be accurate for all scenarios
-    return std::log2(1 + sinr);
-    //SINR to SE Calculation: The calculation of SE from SINR is a simplification using Shannon's formula. 
-    //The actual SE calculation can be more complex and MCS-dependent in real-world scenarios.
+    // Shannon's formula (the default) is an upper bound; the CQI/MCS modes
+    // return the efficiency of the best TS 38.214 table entry the SINR supports
+    return SpectralEfficiency(sinr, g_seMode);
 }
 
-void MySinrCallback(std::string path, uint16_t cellId, uint16_t rnti, double sinr, uint16_t bwpId, uint8_t ccId) {
+void MySinrCallback(uint16_t cellId, uint16_t rnti, double sinr, uint16_t bwpId, uint8_t ccId) {
     double spectralEfficiency = CalculateSpectralEfficiency(sinr);
     // std::cout << "Path: " << path << ", CellId: " << cellId << ", RNTI: " << rnti 
     //           << ", SINR: " << sinr << " dB, SE: " << spectralEfficiency << " bps/Hz" << std::endl;
-    printf("Path: %s,\n CellId: %u,\n RNTI: %u,\n SINR: %lf dB,\n SE: %lf bps/Hz\n", 
-       path.c_str(), cellId, rnti, sinr, spectralEfficiency);
+    WriteTraceRecord(TRACE_SINR, cellId, rnti, bwpId, 0, sinr, spectralEfficiency);
+    if (IsMeasuredUe(cellId, rnti))
+    {
+        g_result.sinr = sinr;
+        g_result.se = spectralEfficiency;
+        g_completion.Notify(CompletionMonitor::SINR);
+    }
+    if (g_linkStatsEnabled)
+    {
+        LinkStats& stats = GetLinkStats(cellId, rnti, bwpId);
+        stats.sinrDb.Add(10.0 * std::log10(sinr));
+        stats.se.Add(spectralEfficiency);
+    }
 }
 
-// Callback for RSSI
-void RssiCallback(double rssi)
+// Callback for RSSI; the PHY is bound at connect time since the trace
+// source does not say which UE it belongs to
+void RssiCallback(Ptr<NrUePhy> phy, double rssi)
 {
-    std::cout << "RSSI: " << rssi << " dBm" << std::endl;
+    WriteTraceRecord(TRACE_RSSI, 0, 0, 0, 0, rssi);
+    if (!g_measureOneUe || phy == g_measuredUePhy)
+    {
+        g_result.rssi = rssi;
+        g_completion.Notify(CompletionMonitor::RSSI);
+    }
+    if (g_linkStatsEnabled)
+    {
+        GetLinkStats(phy->GetCellId(), phy->GetRnti(), phy->GetBwpId()).rssi.Add(rssi);
+    }
 }
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -167,83 +455,518 @@ void LogPosition(NodeContainer nodes)
         Ptr<Node> node = (*i);
         Ptr<MobilityModel> mobility = node->GetObject<MobilityModel>();
         Vector pos = mobility->GetPosition();
-        std::cout << "Node " << node->GetId() << ": Position(" << pos.x << ", " << pos.y << ", " << pos.z << ")" << std::endl;
+        WriteTraceRecord(TRACE_POSITION, 0, 0, 0, node->GetId(), pos.x, pos.y, pos.z);
+        if (!g_measureOneUe || (g_measuredUePhy && node == g_measuredUePhy->GetDevice()->GetNode()))
+        {
+            g_result.x = pos.x;
+            g_result.y = pos.y;
+            g_result.z = pos.z;
+        }
     }
+    g_completion.Notify(CompletionMonitor::POSITION);
     // Schedule the next position log, make sure the time here is reasonable for your simulation
     // Simulator::Schedule(Seconds(1.0), &LogPosition, nodes);
 }
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-float random_pri() {
-    // Create a random number generator engine
-    std::random_device rd;   // Use a hardware random device if available
-    std::mt19937 gen(rd()); // Mersenne Twister engine for 32-bit integers
+/**
+ * Parameters of the scenario, as set from the command line.
+ */
+struct ScenarioConfig
+{
+    uint16_t numerologyBwp1 = 0;
+    uint32_t udpPacketSize = 1000;
+    double centralFrequencyBand1 = 28e9; // 28GHz
+    double bandwidthBand1 = 400e6; // 400MHz
+    uint16_t gNbNum = 1; // one gNodeB
+    uint16_t ueNumPergNb = 1; // one UE device
+    bool enableUl = false;
+    Time sendPacketTime = Seconds(0.4);
+    Time simTime = Seconds(10); // timeout when stopOn is set
+    uint32_t stopOn = 0; // CompletionMonitor measurements ending a replication early
+    Time quiescence = Seconds(0);
+    double pathlossCacheBin = 0.0; // 0 disables the pathloss cache
+    double pathlossCacheMaxErrorDb = 0.5;
+    Time positionInterval = Seconds(0); // 0 disables the position sampler
+    uint32_t gnbAntennaRows = 4;
+    uint32_t gnbAntennaColumns = 8;
+    uint32_t ueAntennaRows = 2;
+    uint32_t ueAntennaColumns = 4;
+    std::string layout = "row"; // row (GridScenarioHelper), grid or hex
+    double interSiteDistance = 200.0; // grid and hex layouts
+    uint16_t sectors = 1; // per site, grid and hex layouts
+    double interferenceRadius = 0.0; // 0 disables interference pruning
+    uint32_t partitions = 1; // strips of sites without radio links between them
+    int32_t partition = -1; // the only strip to build, -1 for all
+    bool measureUe0 = false; // measure UE 0 alone also without partitions
+    std::string traffic = "none"; // none: the single test packet, or cbr, poisson, full
+    double trafficRate = 100e6; // per UE, cbr and poisson [bit/s]
+    uint32_t burstSize = 100000; // poisson [bytes]
+    uint32_t trafficUes = 0; // UEs with a flow, 0 for all
+};
+
+/// Distance between the gNBs of the row layout [m]
+static const double ROW_BS_DISTANCE = 5.0;
+
+/// Antenna heights of the gNBs and UEs [m]
+static const double GNB_HEIGHT = 10.0;
+static const double UE_HEIGHT = 1.5;
+
+/// Range of the initial UE coordinates of the row layout, x and y [m]
+static const double UE_POSITION_MIN = 700.0;
+static const double UE_POSITION_MAX = 800.0;
+
+/// Smallest distance of a UE from its site in the grid and hex layouts [m]
+static const double UE_MIN_SITE_DISTANCE = 10.0;
+
+/**
+ * Sites of the grid and hex layouts, centered on the origin and
+ * interSiteDistance apart: gNbNum sites on a square lattice filled row by
+ * row, or on hexagonal rings around a central site filled ring by ring.
+ * @param config The scenario parameters.
+ */
+static std::vector<Vector>
+SitePositions(const ScenarioConfig& config)
+{
+    const uint32_t count = config.gNbNum;
+    const double isd = config.interSiteDistance;
+    std::vector<Vector> sites;
+    if (config.layout == "grid")
+    {
+        const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(count)));
+        const uint32_t rows = (count + columns - 1) / columns;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            sites.emplace_back((i % columns - (columns - 1) / 2.0) * isd,
+                               (i / columns - (rows - 1) / 2.0) * isd,
+                               GNB_HEIGHT);
+        }
+        return sites;
+    }
 
-    // Define a uniform distribution for floating-point values between 0.0 and 1.0
-    std::uniform_real_distribution<double> distribution(700.0, 800.0);
+    // Axial coordinates (q, r): each ring starts at (-ring, ring) and walks
+    // ring steps along each of the six directions
+    static const int directions[6][2] = {{1, 0}, {1, -1}, {0, -1}, {-1, 0}, {-1, 1}, {0, 1}};
+    std::vector<std::pair<int, int>> cells = {{0, 0}};
+    for (int ring = 1; cells.size() < count; ++ring)
+    {
+        int q = -ring;
+        int r = ring;
+        for (const auto& direction : directions)
+        {
+            for (int step = 0; step < ring; ++step)
+            {
+                cells.emplace_back(q, r);
+                q += direction[0];
+                r += direction[1];
+            }
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        sites.emplace_back(isd * (cells[i].first + cells[i].second / 2.0),
+                           isd * std::sqrt(3.0) / 2.0 * cells[i].second,
+                           GNB_HEIGHT);
+    }
+    return sites;
+}
 
-    // Generate and print random values with a step of 0.1
-    double randomValue;
-    for (double value = 700.0; value <= 800.0; value += 10.0) {
-        randomValue = distribution(gen);
-        // std::cout << "Random Value (" << value << "): " << randomValue << std::endl;
+/**
+ * Partition of each site: the sites, ordered by x and then y, are cut into
+ * config.partitions strips of nearly equal size, so that only the sites
+ * along the cuts have neighbours in another strip.
+ * @param config The scenario parameters.
+ * @param sites The sites, see SitePositions.
+ */
+static std::vector<uint32_t>
+SitePartitions(const ScenarioConfig& config, const std::vector<Vector>& sites)
+{
+    std::vector<uint32_t> order(sites.size());
+    for (uint32_t s = 0; s < order.size(); ++s)
+    {
+        order[s] = s;
     }
-    return randomValue;
+    std::sort(order.begin(), order.end(), [&sites](uint32_t a, uint32_t b) {
+        return sites[a].x < sites[b].x || (sites[a].x == sites[b].x && sites[a].y < sites[b].y);
+    });
+    std::vector<uint32_t> partitions(sites.size());
+    for (uint32_t rank = 0; rank < order.size(); ++rank)
+    {
+        partitions[order[rank]] =
+            static_cast<uint32_t>(static_cast<uint64_t>(rank) * config.partitions / order.size());
+    }
+    return partitions;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////// Main Function //////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Initial positions of the UEs of the current run. UE i of a run always
+ * gets the same position, however the replications are split over
+ * processes or forked.
+ *
+ * In the row layout the UEs are uniform over the square
+ * [UE_POSITION_MIN, UE_POSITION_MAX)^2 at height 0. In the grid and hex
+ * layouts, UE i is uniform over the disc of radius interSiteDistance /
+ * sqrt(3), the hexagonal cell radius, around site i % gNbNum, at least
+ * UE_MIN_SITE_DISTANCE from it.
+ * @param config The scenario parameters.
+ * @param count Number of UEs
+ */
+static std::vector<Vector>
+DrawUePositions(const ScenarioConfig& config, uint32_t count)
+{
+    PhiloxRng rng(RngSeedManager::GetSeed(), RngSeedManager::GetRun(), PHILOX_STREAM_UE_POSITION);
+    std::vector<double> u0(count);
+    std::vector<double> u1(count);
+    rng.UniformBatch(0, count, 0, u0.data());
+    rng.UniformBatch(0, count, 1, u1.data());
+    std::vector<Vector> positions(count);
+    if (config.layout == "row")
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            positions[i] = Vector(UE_POSITION_MIN + (UE_POSITION_MAX - UE_POSITION_MIN) * u0[i],
+                                  UE_POSITION_MIN + (UE_POSITION_MAX - UE_POSITION_MIN) * u1[i],
+                                  0);
+        }
+        return positions;
+    }
 
+    const std::vector<Vector> sites = SitePositions(config);
+    const double rMin2 = UE_MIN_SITE_DISTANCE * UE_MIN_SITE_DISTANCE;
+    const double rMax2 = config.interSiteDistance * config.interSiteDistance / 3.0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const Vector& site = sites[i % sites.size()];
+        double radius = std::sqrt(rMin2 + (rMax2 - rMin2) * u0[i]);
+        double angle = 2 * M_PI * u1[i];
+        positions[i] =
+            Vector(site.x + radius * std::cos(angle), site.y + radius * std::sin(angle), UE_HEIGHT);
+    }
+    return positions;
+}
 
+/**
+ * Sector of a site that faces \p position. Sector k of a site points at
+ * 2 pi k / sectors from the x axis.
+ */
+static uint32_t
+SectorOf(const Vector& site, const Vector& position, uint32_t sectors)
+{
+    const double width = 2 * M_PI / sectors;
+    double bearing = std::atan2(position.y - site.y, position.x - site.x) + width / 2;
+    if (bearing < 0)
+    {
+        bearing += 2 * M_PI;
+    }
+    return static_cast<uint32_t>(bearing / width) % sectors;
+}
 
-int
-main(int argc, char* argv[])
+/// DL MCS used by the gNB scheduler for every transmission
+static const uint8_t FIXED_MCS_DL = 28;
+
+/// Periodic UE position sampler, if --positionInterval is set
+static PositionSampler g_positionSampler;
+
+/// Pathloss cache shared by all replications of this process, if enabled
+static std::shared_ptr<PathlossCache> g_pathlossCache;
+
+/**
+ * Handles to a built scenario, kept so that a template built once can be
+ * re-seeded and run in forked children.
+ */
+struct Scenario
 {
+    Ptr<NrHelper> nrHelper;
+    NetDeviceContainer enbNetDev;
+    NetDeviceContainer ueNetDev;
+    NodeContainer ueNodes;
+    int64_t firstDeviceStream = 0; ///< first stream used by the devices
+};
 
-    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////// Setting Packet size, Amount of UE and gNB, FrequencyBand ///////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    uint16_t numerologyBwp1 = 0;
-    uint32_t udpPacketSize = 1000;
-    double centralFrequencyBand1 = 28e9; // 28GHz
-    double bandwidthBand1 = 400e6; // 400MHz
-    uint16_t gNbNum = 1; // one gNodeB
-    uint16_t ueNumPergNb = 1; // one UE device
-    bool enableUl = false;
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Assign the random streams of the NR devices and their channel, starting
+ * at scenario.firstDeviceStream. The streams take the run that is current
+ * when this is called, so calling it again after RngSeedManager::SetRun
+ * re-seeds an already built scenario.
+ */
+static void
+AssignDeviceStreams(Scenario& scenario)
+{
+    int64_t randomStream = scenario.firstDeviceStream;
+    randomStream += scenario.nrHelper->AssignStreams(scenario.enbNetDev, randomStream);
+    randomStream += scenario.nrHelper->AssignStreams(scenario.ueNetDev, randomStream);
+}
 
+/// Wall time and event count of the replication being run
+static ReplicationTiming g_timing;
 
-    Time sendPacketTime = Seconds(0.4);
+/// Analytic link budget, for --fastPath and --fastPathCheck
+static std::unique_ptr<LinkBudget> g_linkBudget;
+static bool g_fastPathCheck = false;
 
-    CommandLine cmd(__FILE__);
-    cmd.AddValue("numerologyBwp1", "The numerology to be used in bandwidth part 1", numerologyBwp1);
-    cmd.AddValue("centralFrequencyBand1",
-                 "The system frequency to be used in band 1",
-                 centralFrequencyBand1);
-    cmd.AddValue("bandwidthBand1", "The system bandwidth to be used in band 1", bandwidthBand1);
-    cmd.AddValue("packetSize", "packet size in bytes", udpPacketSize);
-    cmd.AddValue("enableUl", "Enable Uplink", enableUl);
-    cmd.Parse(argc, argv);
+/// Per-phase heap growth of the first replication, if --memoryReport is set
+static MemoryReport g_memoryReport;
+/// gNB/UE links of the scenario that are not cut off, for the memory report
+static uint64_t g_memoryReportLinks = 0;
+/// Skip NrHelper::EnableTraces, see --noNrStats
+static bool g_noNrStats = false;
 
-    int64_t randomStream = 1;
-    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    // Create the scenario
-    GridScenarioHelper gridScenario;
+/**
+ * Antenna element model for the antenna arrays of the devices; NrHelper
+ * hands the one instance to every array it installs.
+ * @param directional The 3GPP element, for sectored sites, rather than the
+ * isotropic one
+ */
+static Ptr<AntennaModel>
+MakeAntennaElement(bool directional)
+{
+    if (directional)
+    {
+        return CreateObject<ThreeGppAntennaModel>();
+    }
+    return CreateObject<IsotropicAntennaModel>();
+}
+
+static bool g_profileEvents = false;
+static std::string g_profileStacks; ///< folded-stack output of the event profile, if set
+
+/**
+ * Print the event profile and write its flamegraph stacks.
+ * @param suffix Appended to the stack file name
+ */
+static void
+ReportEventProfile(const std::string& suffix)
+{
+    EventProfile::Get().Report(std::cout);
+    if (!g_profileStacks.empty() && !EventProfile::Get().WriteStacks(g_profileStacks + suffix))
+    {
+        std::cerr << "Cannot write " << g_profileStacks + suffix << std::endl;
+    }
+}
+
+/// Seconds elapsed since \p start
+static double
+SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Reset the per-replication state before a scenario is run
+static void
+BeginReplication()
+{
+    g_rxPdcpCallbackCalled = false;
+    g_rxRxRlcPDUCallbackCalled = false;
+    g_result = ReplicationResult();
+    g_result.run = RngSeedManager::GetRun();
+    g_timing = ReplicationTiming();
+    g_timing.run = g_result.run;
+    g_telemetry.BeginReplication(g_result.run);
+}
+
+/**
+ * Create the gNB and UE nodes and place them on the grid.
+ * @param config The scenario parameters.
+ * @param gridScenario The helper to configure.
+ * @param randomStream First random stream of the helper.
+ * @return The number of streams used.
+ */
+static int64_t
+CreateGrid(const ScenarioConfig& config, GridScenarioHelper& gridScenario, int64_t randomStream)
+{
     gridScenario.SetRows(1);
-    gridScenario.SetColumns(gNbNum);
-    gridScenario.SetHorizontalBsDistance(5.0);
-    gridScenario.SetBsHeight(10.0);
-    gridScenario.SetUtHeight(1.5);
+    gridScenario.SetColumns(config.gNbNum);
+    gridScenario.SetHorizontalBsDistance(ROW_BS_DISTANCE);
+    gridScenario.SetBsHeight(GNB_HEIGHT);
+    gridScenario.SetUtHeight(UE_HEIGHT);
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // must be set before BS number
     gridScenario.SetSectorization(GridScenarioHelper::SINGLE);
-    gridScenario.SetBsNumber(gNbNum);
-    gridScenario.SetUtNumber(ueNumPergNb * gNbNum);
+    gridScenario.SetBsNumber(config.gNbNum);
+    gridScenario.SetUtNumber(config.ueNumPergNb * config.gNbNum);
     gridScenario.SetScenarioHeight(3); // Create a 3x3 scenario where the UE will
     gridScenario.SetScenarioLength(3); // be distribuited.
-    randomStream += gridScenario.AssignStreams(randomStream);
+    int64_t streams = gridScenario.AssignStreams(randomStream);
     gridScenario.CreateScenario();
+    return streams;
+}
+
+/// The gNB and UE nodes of a scenario
+struct Topology
+{
+    NodeContainer gnbNodes; ///< sectors of site s are gNBs s * sectors ... s * sectors + sectors - 1
+    NodeContainer ueNodes;
+    std::vector<Vector> uePositions; ///< initial UE positions, see DrawUePositions
+    std::vector<uint32_t> ueIndex; ///< index of each UE of ueNodes in the whole scenario
+    std::vector<int32_t> nodePartition; ///< partition by node id, with --partitions
+    bool firstUeBuilt = true; ///< whether ueNodes starts with UE 0 of the whole scenario
+};
+
+/**
+ * Create the gNB and UE nodes and place them as --layout says: with
+ * CreateGrid for the row layout, otherwise one gNB per sector at the sites
+ * of SitePositions and the UEs at DrawUePositions.
+ * @param config The scenario parameters.
+ * @param topology Set to the created nodes.
+ * @param randomStream First random stream to use.
+ * @return The number of streams used.
+ */
+static int64_t
+CreateTopology(const ScenarioConfig& config, Topology& topology, int64_t randomStream)
+{
+    if (config.layout == "row")
+    {
+        GridScenarioHelper gridScenario;
+        int64_t streams = CreateGrid(config, gridScenario, randomStream);
+        topology.gnbNodes = gridScenario.GetBaseStations();
+        topology.ueNodes = gridScenario.GetUserTerminals();
+        topology.uePositions = DrawUePositions(config, topology.ueNodes.GetN());
+        for (uint32_t i = 0; i < topology.ueNodes.GetN(); ++i)
+        {
+            topology.ueIndex.push_back(i);
+        }
+        return streams;
+    }
+
+    // UEs belong to the partition of their closest site, the one they
+    // attach to; with config.partition set, only that partition is built
+    const std::vector<Vector> sites = SitePositions(config);
+    const std::vector<uint32_t> sitePartition = SitePartitions(config, sites);
+    SpatialGrid index(config.interSiteDistance);
+    for (uint32_t s = 0; s < sites.size(); ++s)
+    {
+        index.Insert(s, sites[s].x, sites[s].y);
+    }
+    auto built = [&config](uint32_t partition) {
+        return config.partition < 0 || partition == static_cast<uint32_t>(config.partition);
+    };
+
+    Ptr<ListPositionAllocator> gnbPositions = CreateObject<ListPositionAllocator>();
+    std::vector<uint32_t> gnbPartition;
+    std::vector<uint32_t> sitesPerPartition(config.partitions, 0);
+    for (uint32_t s = 0; s < sites.size(); ++s)
+    {
+        if (!built(sitePartition[s]))
+        {
+            continue;
+        }
+        ++sitesPerPartition[sitePartition[s]];
+        for (uint32_t k = 0; k < config.sectors; ++k)
+        {
+            gnbPositions->Add(sites[s]);
+            gnbPartition.push_back(sitePartition[s]);
+        }
+    }
+
+    const uint32_t ueCount = config.ueNumPergNb * config.sectors * static_cast<uint32_t>(sites.size());
+    Ptr<ListPositionAllocator> uePositions = CreateObject<ListPositionAllocator>();
+    std::vector<uint32_t> uePartition;
+    std::vector<uint32_t> uesPerPartition(config.partitions, 0);
+    const std::vector<Vector> positions = DrawUePositions(config, ueCount);
+    for (uint32_t i = 0; i < ueCount; ++i)
+    {
+        uint32_t partition = sitePartition[index.Nearest(positions[i].x, positions[i].y)];
+        if (!built(partition))
+        {
+            topology.firstUeBuilt = topology.firstUeBuilt && i > 0;
+            continue;
+        }
+        ++uesPerPartition[partition];
+        uePositions->Add(positions[i]);
+        topology.uePositions.push_back(positions[i]);
+        topology.ueIndex.push_back(i);
+        uePartition.push_back(partition);
+    }
+    NS_ABORT_MSG_IF(uePartition.empty(), "Partition " << config.partition << " has no UE");
+
+    topology.gnbNodes.Create(gnbPositions->GetSize());
+    topology.ueNodes.Create(uePositions->GetSize());
+    if (config.partitions > 1)
+    {
+        topology.nodePartition.assign(NodeList::GetNNodes(), -1);
+        for (uint32_t i = 0; i < topology.gnbNodes.GetN(); ++i)
+        {
+            topology.nodePartition[topology.gnbNodes.Get(i)->GetId()] = gnbPartition[i];
+        }
+        for (uint32_t i = 0; i < topology.ueNodes.GetN(); ++i)
+        {
+            topology.nodePartition[topology.ueNodes.Get(i)->GetId()] = uePartition[i];
+        }
+        for (uint32_t k = 0; k < config.partitions; ++k)
+        {
+            if (built(k))
+            {
+                std::cout << "PARTITION run=" << RngSeedManager::GetRun() << " partition=" << k
+                          << " sites=" << sitesPerPartition[k] << " ues=" << uesPerPartition[k]
+                          << std::endl;
+            }
+        }
+    }
+
+    MobilityHelper mobility;
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.SetPositionAllocator(gnbPositions);
+    mobility.Install(topology.gnbNodes);
+    mobility.SetPositionAllocator(uePositions);
+    mobility.Install(topology.ueNodes);
+    return 0;
+}
+
+/**
+ * Attach every UE to the sector facing it of its closest site. The sites
+ * are looked up in a spatial index, so this takes O(UEs) rather than the
+ * O(UEs x gNBs) of NrHelper::AttachToClosestEnb, which it matches with one
+ * sector per site.
+ * @param config The scenario parameters.
+ * @param nrHelper The helper that installed the devices.
+ * @param ueNetDev The UE devices.
+ * @param enbNetDev The gNB devices, grouped by site as in Topology.
+ * @return The index in enbNetDev of the gNB of each UE.
+ */
+static std::vector<uint32_t>
+AttachToClosestSector(const ScenarioConfig& config,
+                      Ptr<NrHelper> nrHelper,
+                      const NetDeviceContainer& ueNetDev,
+                      const NetDeviceContainer& enbNetDev)
+{
+    const uint32_t sectors = config.sectors;
+    const uint32_t sites = enbNetDev.GetN() / sectors;
+    SpatialGrid index(config.layout == "row" ? ROW_BS_DISTANCE : config.interSiteDistance);
+    std::vector<Vector> sitePositions(sites);
+    for (uint32_t s = 0; s < sites; ++s)
+    {
+        sitePositions[s] =
+            enbNetDev.Get(s * sectors)->GetNode()->GetObject<MobilityModel>()->GetPosition();
+        index.Insert(s, sitePositions[s].x, sitePositions[s].y);
+    }
+    std::vector<uint32_t> serving(ueNetDev.GetN());
+    for (uint32_t i = 0; i < ueNetDev.GetN(); ++i)
+    {
+        Vector position = ueNetDev.Get(i)->GetNode()->GetObject<MobilityModel>()->GetPosition();
+        uint32_t s = index.Nearest(position.x, position.y);
+        serving[i] = s * sectors + SectorOf(sitePositions[s], position, sectors);
+        nrHelper->AttachToEnb(ueNetDev.Get(i), enbNetDev.Get(serving[i]));
+    }
+    return serving;
+}
+
+/**
+ * Build the topology, install the devices and bind the traces; everything
+ * up to, but not including, Simulator::Run.
+ * @param config The scenario parameters.
+ * @param scenario Set to the handles of the built scenario.
+ */
+static void
+BuildScenario(const ScenarioConfig& config, Scenario& scenario)
+{
+    int64_t randomStream = 1;
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Create the scenario
+    Topology topology;
+    randomStream += CreateTopology(config, topology, randomStream);
+    g_memoryReport.Mark("nodes and mobility",
+                        topology.gnbNodes.GetN() + topology.ueNodes.GetN(),
+                        "node");
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     Ptr<NrPointToPointEpcHelper> epcHelper = CreateObject<NrPointToPointEpcHelper>();
@@ -260,8 +983,8 @@ main(int argc, char* argv[])
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // Create the configuration for the CcBwpHelper
-    CcBwpCreator::SimpleOperationBandConf bandConf1(centralFrequencyBand1,
-                                                    bandwidthBand1,
+    CcBwpCreator::SimpleOperationBandConf bandConf1(config.centralFrequencyBand1,
+                                                    config.bandwidthBand1,
                                                     numCcPerBand,
                                                     BandwidthPartInfo::UMi_StreetCanyon_LoS);
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -270,13 +993,86 @@ main(int argc, char* argv[])
     OperationBandInfo band1 = ccBwpCreator.CreateOperationBandContiguousCc(bandConf1);
 
     Config::SetDefault("ns3::ThreeGppChannelModel::UpdatePeriod", TimeValue(MilliSeconds(0)));
+
+    // Flows of every UE: a slot is 1 ms / 2^numerology, and a slot of the
+    // whole cell carries about one byte per resource element, 168 per RB
+    TrafficEngine::Config traffic;
+    TrafficEngine::ParseModel(config.traffic, traffic.model);
+    traffic.uplink = config.enableUl;
+    traffic.packetSize = config.udpPacketSize;
+    traffic.rateBps = config.trafficRate;
+    traffic.burstBytes = config.burstSize;
+    traffic.slot = NanoSeconds(1000000 >> config.numerologyBwp1);
+    traffic.lossTimeout = MilliSeconds(TRAFFIC_LOSS_TIMEOUT_MS);
+    const double rbs = config.bandwidthBand1 / (12 * 15e3 * (1 << config.numerologyBwp1));
+    traffic.backlogBytes = static_cast<uint32_t>(TRAFFIC_BACKLOG_SLOTS * rbs * 168 / config.ueNumPergNb);
+    g_traffic.Configure(traffic);
+    if (g_traffic.IsEnabled())
+    {
+        // Deliver the flows as they are, in RLC UM with room for a backlog
+        // or a burst, rather than in the saturation mode of RLC SM
+        Config::SetDefault("ns3::LteEnbRrc::EpsBearerToRlcMapping",
+                           EnumValue(LteEnbRrc::RLC_UM_ALWAYS));
+        Config::SetDefault("ns3::LteRlcUm::MaxTxBufferSize",
+                           UintegerValue(2 * std::max(traffic.backlogBytes, traffic.burstBytes)));
+    }
     nrHelper->SetSchedulerAttribute("FixedMcsDl", BooleanValue(true));
-    nrHelper->SetSchedulerAttribute("StartingMcsDl", UintegerValue(28));
+    nrHelper->SetSchedulerAttribute("StartingMcsDl", UintegerValue(FIXED_MCS_DL));
     nrHelper->SetChannelConditionModelAttribute("UpdatePeriod", TimeValue(MilliSeconds(0)));
     nrHelper->SetPathlossAttribute("ShadowingEnabled", BooleanValue(false));
 
     nrHelper->InitializeOperationBand(&band1);
     allBwps = CcBwpCreator::GetAllBwps({band1});
+
+    // Shadowing is disabled and the channel condition is always LoS, so the
+    // pathloss only depends on the geometry and can be served from the cache.
+    // The fast fading of the channel model is drawn per replication and
+    // stays uncached.
+    if (g_pathlossCache)
+    {
+        for (const auto& bwp : allBwps)
+        {
+            CachedPropagationLossModel::Install(bwp.get()->m_channel,
+                                                g_pathlossCache,
+                                                config.pathlossCacheMaxErrorDb);
+        }
+    }
+
+    // In front of the cache, so pruned links cost neither a lookup nor the
+    // fast fading of the channel. When all partitions are built, the links
+    // between them are cut, as they are between processes with --partition.
+    const bool cutPartitions = !topology.nodePartition.empty() && config.partition < 0;
+    Ptr<InterferenceRadiusLossModel> pruning;
+    if (config.interferenceRadius > 0.0 || cutPartitions)
+    {
+        for (const auto& bwp : allBwps)
+        {
+            pruning =
+                InterferenceRadiusLossModel::Install(bwp.get()->m_channel, config.interferenceRadius);
+            if (cutPartitions)
+            {
+                pruning->SetPartitions(topology.nodePartition);
+            }
+        }
+    }
+    if (g_memoryReport.IsActive())
+    {
+        // The links the channel can build state for; the same on every BWP
+        g_memoryReportLinks = 0;
+        for (uint32_t g = 0; g < topology.gnbNodes.GetN(); ++g)
+        {
+            Ptr<MobilityModel> gnb = topology.gnbNodes.Get(g)->GetObject<MobilityModel>();
+            for (uint32_t u = 0; u < topology.ueNodes.GetN(); ++u)
+            {
+                Ptr<MobilityModel> ue = topology.ueNodes.Get(u)->GetObject<MobilityModel>();
+                if (!pruning || !pruning->IsCut(gnb, ue))
+                {
+                    ++g_memoryReportLinks;
+                }
+            }
+        }
+    }
+    g_memoryReport.Mark("band and channel models", 0, "");
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Beamforming method
     idealBeamformingHelper->SetAttribute("BeamformingMethod",
@@ -284,31 +1080,53 @@ main(int argc, char* argv[])
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Antennas for all the UEs
-    nrHelper->SetUeAntennaAttribute("NumRows", UintegerValue(2));
-    nrHelper->SetUeAntennaAttribute("NumColumns", UintegerValue(4));
-    nrHelper->SetUeAntennaAttribute("AntennaElement",
-                                    PointerValue(CreateObject<IsotropicAntennaModel>()));
+    nrHelper->SetUeAntennaAttribute("NumRows", UintegerValue(config.ueAntennaRows));
+    nrHelper->SetUeAntennaAttribute("NumColumns", UintegerValue(config.ueAntennaColumns));
+    nrHelper->SetUeAntennaAttribute("AntennaElement", PointerValue(MakeAntennaElement(false)));
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Antennas for all the gNbs
-    nrHelper->SetGnbAntennaAttribute("NumRows", UintegerValue(4));
-    nrHelper->SetGnbAntennaAttribute("NumColumns", UintegerValue(8));
+    nrHelper->SetGnbAntennaAttribute("NumRows", UintegerValue(config.gnbAntennaRows));
+    nrHelper->SetGnbAntennaAttribute("NumColumns", UintegerValue(config.gnbAntennaColumns));
+    // Sectors need directional elements; isotropic ones radiate as much
+    // to the back of the panel
     nrHelper->SetGnbAntennaAttribute("AntennaElement",
-                                     PointerValue(CreateObject<IsotropicAntennaModel>()));
+                                     PointerValue(MakeAntennaElement(config.sectors > 1)));
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // Install and get the pointers to the NetDevices
     NetDeviceContainer enbNetDev =
-        nrHelper->InstallGnbDevice(gridScenario.GetBaseStations(), allBwps);
+        nrHelper->InstallGnbDevice(topology.gnbNodes, allBwps);
+    g_memoryReport.Mark("gNB devices (PHY, MAC, RRC, array)", enbNetDev.GetN(), "gNB");
     NetDeviceContainer ueNetDev =
-        nrHelper->InstallUeDevice(gridScenario.GetUserTerminals(), allBwps);
-
-    randomStream += nrHelper->AssignStreams(enbNetDev, randomStream);
-    randomStream += nrHelper->AssignStreams(ueNetDev, randomStream);
+        nrHelper->InstallUeDevice(topology.ueNodes, allBwps);
+    g_memoryReport.Mark("UE devices (PHY, MAC, RRC, array)", ueNetDev.GetN(), "UE");
+
+    scenario.nrHelper = nrHelper;
+    scenario.enbNetDev = enbNetDev;
+    scenario.ueNetDev = ueNetDev;
+    scenario.firstDeviceStream = randomStream;
+    AssignDeviceStreams(scenario);
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    // Set the attribute of the netdevice (enbNetDev.Get (0)) and bandwidth part (0)
-    nrHelper->GetGnbPhy(enbNetDev.Get(0), 0)
-        ->SetAttribute("Numerology", UintegerValue(numerologyBwp1));
+    // Set the numerology of bandwidth part (0) of every gNB
+    for (uint32_t i = 0; i < enbNetDev.GetN(); ++i)
+    {
+        nrHelper->GetGnbPhy(enbNetDev.Get(i), 0)
+            ->SetAttribute("Numerology", UintegerValue(config.numerologyBwp1));
+    }
+
+    // Point sector k of every site at 2 pi k / sectors, as SectorOf expects
+    if (config.sectors > 1)
+    {
+        for (uint32_t i = 0; i < enbNetDev.GetN(); ++i)
+        {
+            double bearing = 2 * M_PI * (i % config.sectors) / config.sectors;
+            nrHelper->GetGnbPhy(enbNetDev.Get(i), 0)
+                ->GetSpectrumPhy()
+                ->GetAntenna()
+                ->SetAttribute("BearingAngle", DoubleValue(bearing));
+        }
+    }
 
     for (auto it = enbNetDev.Begin(); it != enbNetDev.End(); ++it)
     {
@@ -323,31 +1141,56 @@ main(int argc, char* argv[])
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     InternetStackHelper internet;
-    internet.Install(gridScenario.GetUserTerminals());
+    internet.Install(topology.ueNodes);
     Ipv4InterfaceContainer ueIpIface;
     ueIpIface = epcHelper->AssignUeIpv4Address(NetDeviceContainer(ueNetDev));
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    if (enableUl)
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // attach UEs to the closest eNB
+    std::vector<uint32_t> serving = AttachToClosestSector(config, nrHelper, ueNetDev, enbNetDev);
+
+    // With partitions, the test packet and the measurements are those of
+    // UE 0 of the whole scenario and its own gNB, whichever process builds
+    // them, so that every partitioning, and the uncut scenario with
+    // --measureUe0, reports the same link
+    g_measuredUePhy = nullptr;
+    g_measureOneUe = config.partitions > 1 || config.measureUe0;
+    g_measuredUeBuilt = topology.firstUeBuilt;
+    if (g_measureOneUe && topology.firstUeBuilt)
     {
-        Simulator::Schedule(sendPacketTime,
+        g_measuredUePhy = DynamicCast<NrUeNetDevice>(ueNetDev.Get(0))->GetPhy(0);
+    }
+    const uint32_t testGnb = g_measureOneUe ? serving[0] : 0;
+    if (g_traffic.IsEnabled())
+    {
+        // The flows replace the test packet, from the same time on
+        for (uint32_t i = 0; i < ueNetDev.GetN(); ++i)
+        {
+            if (config.trafficUes == 0 || topology.ueIndex[i] < config.trafficUes)
+            {
+                g_traffic.AddFlow(ueNetDev.Get(i), enbNetDev.Get(serving[i]), topology.ueIndex[i]);
+            }
+        }
+        g_traffic.Start(config.sendPacketTime);
+        Simulator::ScheduleDestroy(&ReportTraffic);
+    }
+    else if (topology.firstUeBuilt && config.enableUl)
+    {
+        Simulator::Schedule(config.sendPacketTime,
                             &SendPacket,
                             ueNetDev.Get(0),
-                            enbNetDev.Get(0)->GetAddress(),
-                            udpPacketSize);
+                            enbNetDev.Get(testGnb)->GetAddress(),
+                            config.udpPacketSize);
     }
-    else
+    else if (topology.firstUeBuilt)
     {
-        Simulator::Schedule(sendPacketTime,
+        Simulator::Schedule(config.sendPacketTime,
                             &SendPacket,
-                            enbNetDev.Get(0),
+                            enbNetDev.Get(testGnb),
                             ueNetDev.Get(0)->GetAddress(),
-                            udpPacketSize);
+                            config.udpPacketSize);
     }
-
-    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    // attach UEs to the closest eNB
-    nrHelper->AttachToClosestEnb(ueNetDev, enbNetDev);
     /////////////////////////////////////////////////////////////////////////////
 // Define the maximum bounds for the mobility model
 // double x_max = 50.0; // Maximum x-coordinate for UE movement
@@ -388,12 +1231,10 @@ for (NetDeviceContainer::Iterator it = ueNetDev.Begin(); it != ueNetDev.End(); +
 
     //Positioning UEs initially
     Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator>();
-    // for (uint32_t i = 0; i < ueNodes.GetN(); ++i) {
+    for (const Vector& position : topology.uePositions) {
         // positionAlloc->Add(Vector(5.0 * i, 5.0 * i, 0)); // Example positions, modify as needed
-        double x = random_pri();
-        double y = random_pri();
-        positionAlloc->Add(Vector(x, y, 0)); 
-    // }
+        positionAlloc->Add(position);
+    }
 
     // Random Positioning UEs initially
 // double minX = 0; // Maximum x-coordinate 
@@ -452,32 +1293,745 @@ for (uint32_t i = 0; i < ueNetDev.GetN(); i++)
     Ptr<NrSpectrumPhy> ueSpectrumPhy = DynamicCast<NrUeNetDevice>(ueNetDev.Get(i))->GetPhy(0)->GetSpectrumPhy();
     Ptr<NrInterference> ueSpectrumPhyInterference = ueSpectrumPhy->GetNrInterference();
     NS_ABORT_IF(!ueSpectrumPhyInterference);
-    ueSpectrumPhyInterference->TraceConnectWithoutContext("RssiPerProcessedChunk", MakeCallback(&RssiCallback));
+    ueSpectrumPhyInterference->TraceConnectWithoutContext("RssiPerProcessedChunk",
+                                                          MakeBoundCallback(&RssiCallback, DynamicCast<NrUeNetDevice>(ueNetDev.Get(i))->GetPhy(0)));
 }
  /////////////////////////////////////////////////////////////////////////////
 
-    if (enableUl)
+    if (config.enableUl)
     {
         std::cout << "\n Sending data in uplink." << std::endl;
-        Simulator::Schedule(Seconds(0.2), &ConnectUlPdcpRlcTraces);
+        BindUlPdcpRlcTraces(enbNetDev);
     }
     else
     {
         std::cout << "\n Sending data in downlink." << std::endl;
-        Simulator::Schedule(Seconds(0.2), &ConnectPdcpRlcTraces);
+        BindPdcpRlcTraces(ueNetDev);
     }
 
-    nrHelper->EnableTraces();
+    // The stats calculators of NrHelper keep per-UE state and write the NR
+    // stats files; --noNrStats saves both when only the callbacks here are
+    // needed
+    if (!g_noNrStats)
+    {
+        nrHelper->EnableTraces();
+    }
 
-// Connect the SINR trace source to your callback
-    Config::Connect("/NodeList/*/DeviceList/*/$ns3::NrUeNetDevice/ComponentCarrierMapUe/*/NrUePhy/DlDataSinr", MakeCallback(&MySinrCallback));
+// Connect the SINR trace source of every UE PHY to your callback
+    for (auto it = ueNetDev.Begin(); it != ueNetDev.End(); ++it)
+    {
+        Ptr<NrUeNetDevice> ueDev = DynamicCast<NrUeNetDevice>(*it);
+        for (uint32_t bwp = 0; bwp < ueDev->GetCcMapSize(); ++bwp)
+        {
+            ueDev->GetPhy(bwp)->TraceConnectWithoutContext("DlDataSinr", MakeCallback(&MySinrCallback));
+        }
+    }
     Simulator::Schedule(Seconds(0.5), &LogPosition, ueNodes); // Start logging positions after 1 second
-    Simulator::Stop(Seconds(10));
+    if (g_linkStatsEnabled)
+    {
+        Simulator::ScheduleDestroy(&DumpLinkStats);
+    }
+    if (g_positionSampler.IsOpen())
+    {
+        g_positionSampler.SetNodes(ueNodes);
+        g_positionSampler.Start(config.positionInterval);
+        Simulator::ScheduleDestroy(&PositionSampler::Flush, &g_positionSampler);
+    }
+    scenario.ueNodes = ueNodes;
+    g_memoryReport.Mark("IP stack, EPC, bearers and traces", ueNodes.GetN(), "UE");
+}
+
+/**
+ * Predict the measurements of a replication from the analytic link budget
+ * of the first UE, the one the test packet is sent to; the position is that
+ * of the last UE, as LogPosition reports it.
+ * @param gnbNodes The gNB nodes.
+ * @param ueNodes The UE nodes, at their initial position.
+ * @param trace Also write the trace records the full stack would write.
+ * @return The predicted result of the current run.
+ */
+static ReplicationResult
+PredictReplication(const NodeContainer& gnbNodes, const NodeContainer& ueNodes, bool trace)
+{
+    ReplicationResult prediction;
+    prediction.run = RngSeedManager::GetRun();
+    LinkBudget::Link link =
+        g_linkBudget->Compute(ueNodes.Get(0)->GetObject<MobilityModel>(), gnbNodes);
+    prediction.rssi = link.rssiDbm;
+    prediction.sinr = link.sinr;
+    prediction.se = CalculateSpectralEfficiency(link.sinr);
+    // Delivered if the SINR supports the fixed MCS, ignoring HARQ combining
+    prediction.delivered =
+        SpectralEfficiency(link.sinr, SeMode::MCS1) >= MCS_TABLE1_SE[FIXED_MCS_DL];
+    for (uint32_t i = 0; i < ueNodes.GetN(); ++i)
+    {
+        Ptr<Node> node = ueNodes.Get(i);
+        Vector pos = node->GetObject<MobilityModel>()->GetPosition();
+        if (trace)
+        {
+            WriteTraceRecord(TRACE_POSITION, 0, 0, 0, node->GetId(), pos.x, pos.y, pos.z);
+        }
+        prediction.x = pos.x;
+        prediction.y = pos.y;
+        prediction.z = pos.z;
+    }
+    if (trace)
+    {
+        // Cell ids are assigned in gNB install order, starting at 1
+        WriteTraceRecord(TRACE_RSSI, 0, 0, 0, 0, prediction.rssi);
+        WriteTraceRecord(TRACE_SINR, link.gnb + 1, 0, 0, 0, prediction.sinr, prediction.se);
+    }
+    return prediction;
+}
+
+/// Print the prediction of a built scenario as a PREDICTION line
+static void
+PrintPrediction(const Scenario& scenario)
+{
+    NodeContainer gnbNodes;
+    for (auto it = scenario.enbNetDev.Begin(); it != scenario.enbNetDev.End(); ++it)
+    {
+        gnbNodes.Add((*it)->GetNode());
+    }
+    std::cout << FormatResultLine(PredictReplication(gnbNodes, scenario.ueNodes, false),
+                                  "PREDICTION")
+              << std::endl;
+}
+
+/**
+ * Run a built scenario to the end and destroy the simulator.
+ * @param config The scenario parameters.
+ * @return The measurements collected by the trace callbacks.
+ */
+static ReplicationResult
+RunBuiltScenario(const ScenarioConfig& config)
+{
+    Simulator::Stop(config.simTime);
+    g_completion.Start(config.stopOn, config.quiescence);
 
+    if (g_asyncTraceEnabled)
+    {
+        // Anything printed before the run must go out ahead of the traces
+        std::cout.flush();
+        fflush(stdout);
+        g_asyncLog.Start(g_traceWriter.IsOpen() ? &g_traceWriter : nullptr);
+    }
+    g_telemetry.BeginRun(config.simTime.GetTimeStep());
+    auto start = std::chrono::steady_clock::now();
+    EventProfile::Get().BeginRun();
     Simulator::Run();
+    g_timing.runSeconds = SecondsSince(start);
+    g_telemetry.EndRun();
+    g_timing.simSeconds = Simulator::Now().GetSeconds();
+    g_timing.events = Simulator::GetEventCount();
+    EventProfile::Get().EndRun();
+    // Everything the run allocates: the per-link state the channel builds
+    // on the first transmission of a link, but also the event queue, RLC
+    // and PDCP buffers, trace rings and traffic, so the bytes per link are
+    // an upper bound on the channel state
+    g_memoryReport.Mark("run (all)", g_memoryReportLinks, "gNB/UE link");
+    g_memoryReport.End();
+    if (g_asyncTraceEnabled)
+    {
+        uint64_t dropped = g_asyncLog.Stop();
+        if (dropped > 0)
+        {
+            std::cerr << "Run " << g_result.run << ": dropped " << dropped
+                      << " trace records" << std::endl;
+        }
+    }
+    if (config.stopOn != 0 && !g_completion.IsComplete())
+    {
+        std::cerr << "Run " << g_result.run << ": timed out at " << config.simTime.As(Time::S)
+                  << " before --stopOn was satisfied" << std::endl;
+    }
     Simulator::Destroy();
+    g_measuredUePhy = nullptr;
+
+    g_result.delivered = g_rxPdcpCallbackCalled && g_rxRxRlcPDUCallbackCalled;
+    return g_result;
+}
+
+/**
+ * Build the scenario, run it and destroy the simulator, so that it can be
+ * called once per replication within the same process. The caller selects
+ * the replication through RngSeedManager before calling it.
+ * @param config The scenario parameters.
+ * @return The measurements collected by the trace callbacks.
+ */
+static ReplicationResult
+RunScenario(const ScenarioConfig& config)
+{
+    BeginReplication();
+    auto start = std::chrono::steady_clock::now();
+    Scenario scenario;
+    BuildScenario(config, scenario);
+    g_timing.setupSeconds = SecondsSince(start);
+    if (g_fastPathCheck)
+    {
+        PrintPrediction(scenario);
+    }
+    return RunBuiltScenario(config);
+}
+
+/**
+ * Move the UEs of a built scenario to the initial positions of the current
+ * run, the way BuildScenario places them. The UEs stay attached to the
+ * gNBs they were attached to, which is only right with a single gNB: with
+ * several, a new drop can be closer to another site or face another sector,
+ * so --forkReplications is refused there.
+ * @param config The scenario parameters.
+ * @param ueNodes The UEs.
+ */
+static void
+RepositionUes(const ScenarioConfig& config, NodeContainer ueNodes)
+{
+    std::vector<Vector> positions = DrawUePositions(config, ueNodes.GetN());
+    for (uint32_t i = 0; i < ueNodes.GetN(); ++i)
+    {
+        const Vector& position = positions[i];
+        Ptr<Node> node = ueNodes.Get(i);
+        node->GetObject<MobilityModel>()->SetPosition(position);
+        std::cout << "Initial position of Node " << node->GetId() << ": (" << position.x << ", "
+                  << position.y << ", " << position.z << ")" << std::endl;
+    }
+}
+
+/**
+ * Run a replication on the analytic link budget alone: place the nodes as
+ * BuildScenario does, but without devices, stack or simulator events.
+ * @param config The scenario parameters.
+ * @return The predicted measurements.
+ */
+static ReplicationResult
+RunFastPath(const ScenarioConfig& config)
+{
+    BeginReplication();
+    auto start = std::chrono::steady_clock::now();
+    Topology topology;
+    CreateTopology(config, topology, 1);
+    RepositionUes(config, topology.ueNodes);
+    g_timing.setupSeconds = SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    g_result = PredictReplication(topology.gnbNodes, topology.ueNodes, true);
+    g_timing.runSeconds = SecondsSince(start);
+    g_telemetry.EndRun();
+    // Releases the nodes
+    Simulator::Destroy();
+    return g_result;
+}
+
+/**
+ * Build the scenario once and run every replication in a fork()ed,
+ * copy-on-write child of it, so the setup cost is paid once.
+ *
+ * Each child switches to its own run, re-assigns the device and channel
+ * streams, moves the UEs to a fresh random position, runs, and sends its
+ * result back through a pipe. Streams that ns-3 numbers automatically
+ * (i.e. those not covered by NrHelper::AssignStreams) keep the run of the
+ * template. Pathloss cache entries learned by the children are not
+ * merged back.
+ * @param config The scenario parameters.
+ * @param firstRun Run of the first replication; also used for the template.
+ * @param replications Number of replications.
+ * @param maxChildren Number of children run at the same time.
+ * @param results Set to the result of each replication, in run order.
+ * @param timings Set to the cost of each replication, in run order; the
+ * setup time is that of the shared template.
+ */
+static void
+RunForkedReplications(const ScenarioConfig& config,
+                      uint64_t firstRun,
+                      uint32_t replications,
+                      uint32_t maxChildren,
+                      std::vector<ReplicationResult>& results,
+                      std::vector<ReplicationTiming>& timings)
+{
+    RngSeedManager::SetRun(firstRun);
+    BeginReplication();
+    auto start = std::chrono::steady_clock::now();
+    Scenario scenario;
+    BuildScenario(config, scenario);
+    const double setupSeconds = SecondsSince(start);
+    g_telemetry.SetState(TELEMETRY_FORKING);
+
+    /// What a child sends back through its pipe
+    struct ChildReport
+    {
+        ReplicationResult result;
+        ReplicationTiming timing;
+    };
+
+    struct Child
+    {
+        pid_t pid;
+        int fd;
+        uint32_t replication;
+    };
+
+    std::vector<Child> children;
+    results.assign(replications, ReplicationResult());
+    timings.assign(replications, ReplicationTiming());
+
+    // Wait for any child and collect its result; a child that died before
+    // reporting counts as an undelivered replication.
+    auto reapOne = [&]() {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        for (auto it = children.begin(); it != children.end(); ++it)
+        {
+            if (it->pid != pid)
+            {
+                continue;
+            }
+            ChildReport report;
+            if (read(it->fd, &report, sizeof(report)) != static_cast<ssize_t>(sizeof(report)))
+            {
+                report = ChildReport();
+                report.result.run = firstRun + it->replication;
+                report.timing.run = report.result.run;
+                std::cerr << "Replication with run " << report.result.run << " failed" << std::endl;
+            }
+            results[it->replication] = report.result;
+            timings[it->replication] = report.timing;
+            g_telemetry.EndReplication();
+            close(it->fd);
+            children.erase(it);
+            return;
+        }
+    };
+
+    for (uint32_t k = 0; k < replications; ++k)
+    {
+        while (children.size() >= maxChildren)
+        {
+            reapOne();
+        }
+
+        // Anything still buffered would be written once by every child
+        std::cout.flush();
+        fflush(stdout);
+        g_traceWriter.Flush();
+
+        int fds[2];
+        NS_ABORT_MSG_IF(pipe(fds) != 0, "pipe() failed");
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "fork() failed");
+        if (pid == 0)
+        {
+            close(fds[0]);
+            // The parent's segment stays the parent's; each child reports
+            // its replication in a segment of its own
+            if (g_telemetry.IsOpen())
+            {
+                g_telemetry.Detach();
+                g_telemetry.Open(Seconds(1).GetTimeStep(), 1, getppid());
+                ProfilingScheduler::SetTelemetry(g_telemetry.Counters());
+            }
+            RngSeedManager::SetRun(firstRun + k);
+            BeginReplication();
+            AssignDeviceStreams(scenario);
+            RepositionUes(config, scenario.ueNodes);
+            g_timing.setupSeconds = setupSeconds;
+            if (g_fastPathCheck)
+            {
+                PrintPrediction(scenario);
+            }
+            ChildReport report;
+            report.result = RunBuiltScenario(config);
+            report.timing = g_timing;
+            ssize_t written = write(fds[1], &report, sizeof(report));
+            // The profile of a child is lost with it, so each child reports
+            // its own
+            if (g_profileEvents)
+            {
+                ReportEventProfile("." + std::to_string(report.result.run));
+            }
+            g_traceWriter.Close();
+            g_positionSampler.Close();
+            g_telemetry.Close();
+            std::cout.flush();
+            fflush(stdout);
+            // Skip the static destructors of the parent's state
+            _exit(written == static_cast<ssize_t>(sizeof(report)) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        close(fds[1]);
+        children.push_back({pid, fds[0], k});
+    }
+    while (!children.empty())
+    {
+        reapOne();
+    }
+
+    // The template itself is never run
+    Simulator::Destroy();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////// Main Function //////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+
+int
+main(int argc, char* argv[])
+{
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////// Setting Packet size, Amount of UE and gNB, FrequencyBand ///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ScenarioConfig config;
+    uint32_t replications = 1;
+    std::string traceFile;
+    std::string pathlossCacheFile;
+    std::string seMode = "shannon";
+    std::string positionFile = "ue-positions.bin";
+    std::string traceBackpressure = "block";
+    std::string scheduler = "map";
+    std::string stopOn;
+    bool forkReplications = false;
+    bool fastPath = false;
+    bool memoryReport = false;
+    bool telemetry = false;
+    Time profileWindow = MilliSeconds(100);
+    uint32_t forkJobs = std::max(1u, std::thread::hardware_concurrency());
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("numerologyBwp1", "The numerology to be used in bandwidth part 1", config.numerologyBwp1);
+    cmd.AddValue("centralFrequencyBand1",
+                 "The system frequency to be used in band 1",
+                 config.centralFrequencyBand1);
+    cmd.AddValue("bandwidthBand1", "The system bandwidth to be used in band 1", config.bandwidthBand1);
+    cmd.AddValue("packetSize", "packet size in bytes", config.udpPacketSize);
+    cmd.AddValue("enableUl", "Enable Uplink", config.enableUl);
+    cmd.AddValue("traffic",
+                 "Traffic of each UE in place of the single test packet, from the same time "
+                 "on: none, cbr (--trafficRate), poisson (bursts of --burstSize at a mean of "
+                 "--trafficRate) or full (full buffer); DL, or UL with --enableUl",
+                 config.traffic);
+    cmd.AddValue("trafficRate", "Rate of each cbr or poisson flow [bit/s]", config.trafficRate);
+    cmd.AddValue("burstSize", "Size of the poisson bursts [bytes]", config.burstSize);
+    cmd.AddValue("trafficUes",
+                 "Only UEs 0 .. trafficUes - 1 of the scenario get a flow; 0 for all",
+                 config.trafficUes);
+    cmd.AddValue("gNbNum",
+                 "Number of gNBs in one row, or of sites with --layout=grid or hex",
+                 config.gNbNum);
+    cmd.AddValue("ueNumPergNb", "Number of UEs per gNB (per sector)", config.ueNumPergNb);
+    cmd.AddValue("layout",
+                 "Placement of the gNBs: row (5 m apart, the UEs in a 100 m square), grid "
+                 "(square lattice) or hex (hexagonal rings), the last two with the UEs "
+                 "dropped around their sites",
+                 config.layout);
+    cmd.AddValue("interSiteDistance",
+                 "Distance between neighbouring sites of the grid and hex layouts [m]",
+                 config.interSiteDistance);
+    cmd.AddValue("sectors", "Sectors per site of the grid and hex layouts: 1 or 3", config.sectors);
+    cmd.AddValue("interferenceRadius",
+                 "Neither compute nor deliver the signal of links longer than this "
+                 "horizontal distance [m]; must exceed the serving links. 0 computes all "
+                 "gNB/UE pairs",
+                 config.interferenceRadius);
+    cmd.AddValue("simTime",
+                 "Simulated time of each replication; the timeout with --stopOn",
+                 config.simTime);
+    cmd.AddValue("stopOn",
+                 "Stop a replication once all of these were seen: comma separated pdcp, rlc, "
+                 "sinr, rssi, position (e.g. pdcp,rlc,sinr,position)",
+                 stopOn);
+    cmd.AddValue("quiescence",
+                 "With --stopOn, wait this long without further required events before stopping",
+                 config.quiescence);
+    cmd.AddValue("replications",
+                 "Number of replications to run back-to-back in this process, "
+                 "using consecutive RngRun values starting from --RngRun",
+                 replications);
+    cmd.AddValue("traceFile",
+                 "If set, write the SINR, RSSI, RLC, PDCP and position traces to this "
+                 "file as binary records (see trace-record.h) instead of printing them",
+                 traceFile);
+    cmd.AddValue("linkStats",
+                 "Print the distribution of SINR, RSSI and SE per cell/RNTI/BWP at the end "
+                 "of each replication",
+                 g_linkStatsEnabled);
+    cmd.AddValue("pathlossCacheBin",
+                 "Bin size in meters of the pathloss cache keyed on the UE position relative "
+                 "to the gNB; 0 disables the cache. Only the pathloss is cached, not the "
+                 "channel matrices or beams",
+                 config.pathlossCacheBin);
+    cmd.AddValue("pathlossCacheMaxErrorDb",
+                 "Largest pathloss error in dB the cache may introduce; shorter links are "
+                 "computed exactly",
+                 config.pathlossCacheMaxErrorDb);
+    cmd.AddValue("pathlossCacheFile",
+                 "File to warm-start the pathloss cache from and to save it to at the end",
+                 pathlossCacheFile);
+    cmd.AddValue("seMode",
+                 "SINR to spectral efficiency mapping: shannon, or the TS 38.214 tables "
+                 "cqi1, cqi2, mcs1, mcs2",
+                 seMode);
+    cmd.AddValue("positionInterval",
+                 "Sample the position of every UE with this period into --positionFile; "
+                 "0 disables sampling",
+                 config.positionInterval);
+    cmd.AddValue("positionFile",
+                 "Binary file for the UE trajectories (see position-sampler.h)",
+                 positionFile);
+    cmd.AddValue("asyncTrace",
+                 "Hand the traces to a background thread through a lock-free ring "
+                 "instead of writing them from the simulation thread",
+                 g_asyncTraceEnabled);
+    cmd.AddValue("traceBackpressure",
+                 "What --asyncTrace does when the ring is full: block, or drop (and count)",
+                 traceBackpressure);
+    cmd.AddValue("profileEvents",
+                 "Profile the wall time spent per event type and per simulated-time window, "
+                 "and print it at the end",
+                 g_profileEvents);
+    cmd.AddValue("profileWindow", "Simulated-time window of the event profile", profileWindow);
+    cmd.AddValue("profileStacks",
+                 "Also write the event profile to this file in flamegraph folded-stack format",
+                 g_profileStacks);
+    cmd.AddValue("scheduler",
+                 "Event scheduler: map, heap, list, calendar, or slot-calendar (a calendar "
+                 "queue with one OFDM symbol per bucket)",
+                 scheduler);
+    cmd.AddValue("fastPath",
+                 "Compute RSSI, SINR and SE from the analytic link budget instead of "
+                 "running the NR stack",
+                 fastPath);
+    cmd.AddValue("fastPathCheck",
+                 "Also print the analytic link budget of every full-stack replication, as a "
+                 "PREDICTION line",
+                 g_fastPathCheck);
+    cmd.AddValue("partitions",
+                 "Cut the sites of the grid and hex layouts into this many strips along x, "
+                 "with no radio link between strips, and measure UE 0 alone. This drops "
+                 "the interference across strips: an approximation of the whole scenario",
+                 config.partitions);
+    cmd.AddValue("partition",
+                 "Build only this strip of --partitions, with its sites and UEs, e.g. one "
+                 "strip per process; -1 builds all of them in this process",
+                 config.partition);
+    cmd.AddValue("measureUe0",
+                 "Measure UE 0 alone, on the link to its own gNB, as with --partitions: "
+                 "the uncut reference of a partitioned run",
+                 config.measureUe0);
+    cmd.AddValue("memoryReport",
+                 "Print the heap growth of each phase of the first replication, per gNB, "
+                 "UE and gNB/UE link not cut off (the build phases only with "
+                 "--forkReplications)",
+                 memoryReport);
+    cmd.AddValue("noNrStats",
+                 "Skip NrHelper::EnableTraces: no NR stats calculators and no NR stats "
+                 "files (RxPacketTrace.txt etc.), which saves their per-UE memory",
+                 g_noNrStats);
+    cmd.AddValue("telemetry",
+                 "Publish the progress of the replications (simulated time, events, queue "
+                 "depth, trace callbacks) in the shared memory segment /5gsim-<pid>, for "
+                 "Main5G-loop --monitor",
+                 telemetry);
+    cmd.AddValue("forkReplications",
+                 "Build the scenario once and run each replication in a forked copy of it; "
+                 "single gNB only",
+                 forkReplications);
+    cmd.AddValue("forkJobs",
+                 "Number of forked replications run at the same time",
+                 forkJobs);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_UNLESS(ParseSeMode(seMode, g_seMode), "Unknown --seMode " << seMode);
+    NS_ABORT_MSG_UNLESS(config.layout == "row" || config.layout == "grid" || config.layout == "hex",
+                        "Unknown --layout " << config.layout);
+    NS_ABORT_MSG_UNLESS(config.sectors == 1 || config.sectors == 3,
+                        "--sectors must be 1 or 3, not " << config.sectors);
+    NS_ABORT_MSG_IF(config.layout == "row" && config.sectors != 1,
+                    "--sectors needs --layout=grid or hex");
+    // A forked replication moves the UEs of the template without attaching
+    // them again, so each must stay closest to the gNB it is attached to
+    NS_ABORT_MSG_IF(forkReplications && config.gNbNum * config.sectors > 1,
+                    "--forkReplications keeps the attachment of the template, so it needs a "
+                    "single gNB: drop it or use --gNbNum=1 --sectors=1");
+    TrafficEngine::Model trafficModel;
+    NS_ABORT_MSG_UNLESS(TrafficEngine::ParseModel(config.traffic, trafficModel),
+                        "Unknown --traffic " << config.traffic);
+    NS_ABORT_MSG_IF(trafficModel != TrafficEngine::NONE && fastPath,
+                    "--traffic needs the NR stack, drop --fastPath");
+    NS_ABORT_MSG_IF(config.trafficRate <= 0 || config.burstSize == 0 || config.udpPacketSize == 0,
+                    "--trafficRate, --burstSize and --packetSize must be positive");
+
+    if (config.partition >= 0)
+    {
+        NS_ABORT_MSG_IF(forkReplications || fastPath,
+                        "--partition runs the full stack of one strip, drop --forkReplications "
+                        "and --fastPath");
+        NS_ABORT_MSG_IF(config.partition >= static_cast<int32_t>(config.partitions),
+                        "--partition must be below --partitions");
+        // One file per strip
+        if (config.partition > 0)
+        {
+            const std::string suffix = ".part" + std::to_string(config.partition);
+            traceFile += traceFile.empty() ? "" : suffix;
+            positionFile += suffix;
+        }
+    }
+    NS_ABORT_MSG_IF(config.partitions < 1 || config.partitions > config.gNbNum,
+                    "--partitions must be between 1 and the number of sites");
+    NS_ABORT_MSG_IF(config.partitions > 1 && config.layout == "row",
+                    "--partitions needs --layout=grid or hex");
+    NS_ABORT_MSG_UNLESS(CompletionMonitor::ParseMeasurements(stopOn, config.stopOn),
+                        "Unknown measurement in --stopOn " << stopOn);
+    NS_ABORT_MSG_UNLESS(traceBackpressure == "block" || traceBackpressure == "drop",
+                        "Unknown --traceBackpressure " << traceBackpressure);
+    g_asyncLog.SetBackpressure(traceBackpressure == "drop" ? AsyncTraceLog::DROP
+                                                           : AsyncTraceLog::BLOCK);
+
+    const std::map<std::string, TypeId> schedulers = {
+        {"map", MapScheduler::GetTypeId()},
+        {"heap", HeapScheduler::GetTypeId()},
+        {"list", ListScheduler::GetTypeId()},
+        {"calendar", CalendarScheduler::GetTypeId()},
+        {"slot-calendar", SlotCalendarScheduler::GetTypeId()},
+    };
+    auto schedulerType = schedulers.find(scheduler);
+    NS_ABORT_MSG_IF(schedulerType == schedulers.end(), "Unknown --scheduler " << scheduler);
+    // Slot duration 1 ms / 2^numerology, 14 symbols per slot
+    Config::SetDefault("ns3::SlotCalendarScheduler::BucketWidth",
+                       TimeValue(NanoSeconds(1000000 / (1 << config.numerologyBwp1) / 14)));
+
+    if (telemetry)
+    {
+        NS_ABORT_MSG_UNLESS(g_telemetry.Open(Seconds(1).GetTimeStep(), replications),
+                            "Cannot create the telemetry segment");
+        ProfilingScheduler::SetTelemetry(g_telemetry.Counters());
+    }
+
+    // The scheduler type is a global value, so it also applies to the
+    // simulators created after Simulator::Destroy for later replications.
+    // The telemetry counts the events in the profiling scheduler, without
+    // profiling them unless asked to.
+    if (g_profileEvents || telemetry)
+    {
+        Config::SetDefault("ns3::ProfilingScheduler::WrappedScheduler",
+                           TypeIdValue(schedulerType->second));
+        Config::SetDefault("ns3::ProfilingScheduler::Profile", BooleanValue(g_profileEvents));
+        GlobalValue::Bind("SchedulerType", TypeIdValue(ProfilingScheduler::GetTypeId()));
+        EventProfile::Get().SetWindow(profileWindow);
+    }
+    else
+    {
+        GlobalValue::Bind("SchedulerType", TypeIdValue(schedulerType->second));
+    }
+
+    if (config.pathlossCacheBin > 0.0)
+    {
+        g_pathlossCache =
+            std::make_shared<PathlossCache>(config.pathlossCacheBin, config.centralFrequencyBand1);
+        if (!pathlossCacheFile.empty())
+        {
+            std::size_t loaded = g_pathlossCache->Load(pathlossCacheFile);
+            std::cout << "Loaded " << loaded << " pathloss cache entries" << std::endl;
+        }
+    }
+
+    if (fastPath || g_fastPathCheck)
+    {
+        NS_ABORT_MSG_IF(fastPath && forkReplications,
+                        "--fastPath has no scenario to fork, drop --forkReplications");
+        g_linkBudget = std::make_unique<LinkBudget>(
+            config.centralFrequencyBand1,
+            config.bandwidthBand1,
+            config.numerologyBwp1,
+            config.gnbAntennaRows * config.gnbAntennaColumns,
+            config.ueAntennaRows * config.ueAntennaColumns);
+        if (g_pathlossCache)
+        {
+            g_linkBudget->SetPathlossCache(g_pathlossCache, config.pathlossCacheMaxErrorDb);
+        }
+    }
+
+    if (config.positionInterval.IsStrictlyPositive())
+    {
+        NS_ABORT_MSG_UNLESS(g_positionSampler.Open(positionFile),
+                            "Cannot create position file " << positionFile);
+    }
+
+    if (!traceFile.empty())
+    {
+        NS_ABORT_MSG_UNLESS(g_traceWriter.Open(traceFile), "Cannot create trace file " << traceFile);
+    }
+
+    // Each replication gets its own run number of the same seed, so that
+    // replication k of a batch draws the same ns-3 streams as a single run
+    // started with RngRun + k.
+    const uint64_t firstRun = RngSeedManager::GetRun();
+    bool allDelivered = true;
+    if (memoryReport)
+    {
+        g_memoryReport.Begin();
+    }
+    if (forkReplications)
+    {
+        std::vector<ReplicationResult> results;
+        std::vector<ReplicationTiming> timings;
+        RunForkedReplications(config,
+                              firstRun,
+                              replications,
+                              std::max(1u, forkJobs),
+                              results,
+                              timings);
+        for (uint32_t k = 0; k < replications; ++k)
+        {
+            std::cout << FormatResultLine(results[k]) << std::endl;
+            std::cout << FormatTimingLine(timings[k]) << std::endl;
+            allDelivered = allDelivered && results[k].delivered;
+        }
+    }
+    else
+    {
+        for (uint32_t k = 0; k < replications; ++k)
+        {
+            RngSeedManager::SetRun(firstRun + k);
+            ReplicationResult result = fastPath ? RunFastPath(config) : RunScenario(config);
+            // With --partition, the process that built UE 0 reports the run
+            if (g_measureOneUe && !g_measuredUeBuilt)
+            {
+                continue;
+            }
+            std::cout << FormatResultLine(result) << std::endl;
+            std::cout << FormatTimingLine(g_timing) << std::endl;
+            allDelivered = allDelivered && result.delivered;
+        }
+    }
+    g_traceWriter.Close();
+    g_positionSampler.Close();
+
+    if (g_profileEvents && !forkReplications)
+    {
+        ReportEventProfile("");
+    }
+
+    if (memoryReport)
+    {
+        g_memoryReport.Print(std::cout);
+    }
+
+    if (g_pathlossCache)
+    {
+        std::cout << "Pathloss cache: " << g_pathlossCache->GetSize() << " entries, "
+                  << g_pathlossCache->GetHits() << " hits, " << g_pathlossCache->GetMisses()
+                  << " misses" << std::endl;
+        if (!pathlossCacheFile.empty() && !g_pathlossCache->Save(pathlossCacheFile))
+        {
+            std::cerr << "Cannot save the pathloss cache to " << pathlossCacheFile << std::endl;
+        }
+    }
+
+    g_telemetry.Close();
 
-    if (g_rxPdcpCallbackCalled && g_rxRxRlcPDUCallbackCalled)
+    if (allDelivered)
     {
         return EXIT_SUCCESS;
     }
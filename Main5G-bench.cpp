@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "replication-result.h"
+#include "worker-pool.h"
+
+/**
+ * Benchmark of 5Gmain.cc against the scale of the scenario.
+ *
+ * Runs 5Gmain.cc once per configuration of the grid gNbNum x ueNumPergNb x
+ * numerology x bandwidth x event scheduler, one process at a time so that
+ * the measurements do not disturb each other, and reports per configuration:
+ *  - setup and run wall time, from the TIMING lines of 5Gmain.cc,
+ *  - wall time per simulated second and events per wall second,
+ *  - peak RSS of the process tree, from wait4().
+ * The results are written as JSON with one configuration per line, and can
+ * be compared against the JSON of an earlier run with --baseline. With more
+ * than one --scheduler, the run time of each scheduler is also summarized
+ * relative to the first one.
+ */
+
+// Split a comma separated list of command line values
+std::vector<std::string> SplitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// One configuration of the benchmark grid and what it measured
+struct BenchCase {
+    int gNbNum;
+    int ueNumPergNb;
+    int numerology;
+    double bandwidth;
+    std::string scheduler;
+    bool ok = false;
+    double setupSeconds = 0.0;
+    double runSeconds = 0.0;
+    double simSeconds = 0.0;
+    double events = 0.0;
+    long peakRssKb = 0;
+
+    double WallPerSimSecond() const {
+        return simSeconds > 0.0 ? runSeconds / simSeconds : 0.0;
+    }
+
+    double EventsPerSecond() const {
+        return runSeconds > 0.0 ? events / runSeconds : 0.0;
+    }
+
+    std::tuple<int, int, int, double, std::string> Key() const {
+        return std::make_tuple(gNbNum, ueNumPergNb, numerology, bandwidth, scheduler);
+    }
+
+    std::string Args() const {
+        char args[192];
+        snprintf(args, sizeof(args),
+                 "--gNbNum=%d --ueNumPergNb=%d --numerologyBwp1=%d --bandwidthBand1=%g --scheduler=%s", gNbNum,
+                 ueNumPergNb, numerology, bandwidth, scheduler.c_str());
+        return args;
+    }
+
+    std::string Json() const {
+        char json[512];
+        snprintf(json, sizeof(json),
+                 "{\"gNbNum\": %d, \"ueNumPergNb\": %d, \"numerology\": %d, \"bandwidth\": %g, "
+                 "\"scheduler\": \"%s\", \"ok\": %s, \"setupSeconds\": %.6f, \"runSeconds\": %.6f, \"simSeconds\": %.6f, "
+                 "\"events\": %.0f, \"wallPerSimSecond\": %.6f, \"eventsPerSecond\": %.1f, "
+                 "\"peakRssKb\": %ld}",
+                 gNbNum, ueNumPergNb, numerology, bandwidth, scheduler.c_str(), ok ? "true" : "false", setupSeconds,
+                 runSeconds, simSeconds, events, WallPerSimSecond(), EventsPerSecond(), peakRssKb);
+        return json;
+    }
+};
+
+// Read the number stored under "key" in a line written by BenchCase::Json
+bool JsonNumber(const std::string& line, const std::string& key, double& value) {
+    size_t pos = line.find("\"" + key + "\":");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    return sscanf(line.c_str() + pos + key.size() + 3, " %lf", &value) == 1;
+}
+
+// Read the string stored under "key" in a line written by BenchCase::Json
+bool JsonString(const std::string& line, const std::string& key, std::string& value) {
+    size_t pos = line.find("\"" + key + "\": \"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos += key.size() + 5;
+    size_t end = line.find('"', pos);
+    if (end == std::string::npos) {
+        return false;
+    }
+    value = line.substr(pos, end - pos);
+    return true;
+}
+
+// Load the cases of an earlier benchmark output
+std::vector<BenchCase> LoadBaseline(const std::string& path) {
+    std::vector<BenchCase> cases;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        BenchCase c;
+        double gNbNum, ueNumPergNb, numerology, events, peakRssKb;
+        if (!JsonNumber(line, "gNbNum", gNbNum) || !JsonNumber(line, "ueNumPergNb", ueNumPergNb) ||
+            !JsonNumber(line, "numerology", numerology) || !JsonNumber(line, "bandwidth", c.bandwidth) ||
+            !JsonNumber(line, "setupSeconds", c.setupSeconds) || !JsonNumber(line, "runSeconds", c.runSeconds) ||
+            !JsonNumber(line, "simSeconds", c.simSeconds) || !JsonNumber(line, "events", events) ||
+            !JsonNumber(line, "peakRssKb", peakRssKb)) {
+            continue;
+        }
+        c.gNbNum = static_cast<int>(gNbNum);
+        c.ueNumPergNb = static_cast<int>(ueNumPergNb);
+        c.numerology = static_cast<int>(numerology);
+        c.events = events;
+        c.peakRssKb = static_cast<long>(peakRssKb);
+        // Baselines from before the scheduler dimension ran the default
+        if (!JsonString(line, "scheduler", c.scheduler)) {
+            c.scheduler = "map";
+        }
+        c.ok = line.find("\"ok\": true") != std::string::npos;
+        cases.push_back(c);
+    }
+    return cases;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> gNbNums{"1", "2"};
+    std::vector<std::string> ueNums{"1", "4"};
+    std::vector<std::string> numerologies{"0", "1", "2", "3", "4"};
+    std::vector<std::string> bandwidths{"20e6", "100e6", "400e6"};
+    std::vector<std::string> schedulers{"map"};
+    std::string simTime = "1s";
+    int repeat = 1;
+    std::string program = "./ns3";
+    std::string extraArgs;
+    std::string outPath = "bench.json";
+    std::string baselinePath;
+    double tolerance = 0.15;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+            std::cerr << "Unrecognized argument: " << arg << std::endl;
+            return 1;
+        }
+        std::string key = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+        if (key == "gNbNum") {
+            gNbNums = SplitList(value);
+        } else if (key == "ueNumPergNb") {
+            ueNums = SplitList(value);
+        } else if (key == "numerologyBwp1") {
+            numerologies = SplitList(value);
+        } else if (key == "bandwidthBand1") {
+            bandwidths = SplitList(value);
+        } else if (key == "scheduler") {
+            schedulers = SplitList(value);
+        } else if (key == "simTime") {
+            simTime = value;
+        } else if (key == "repeat") {
+            repeat = std::max(1, std::stoi(value));
+        } else if (key == "program") {
+            program = value;
+        } else if (key == "args") {
+            extraArgs = value;
+        } else if (key == "out") {
+            outPath = value;
+        } else if (key == "baseline") {
+            baselinePath = value;
+        } else if (key == "tolerance") {
+            tolerance = std::stod(value);
+        } else {
+            std::cerr << "Unrecognized argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    const bool viaNs3 = program == "./ns3";
+    if (viaNs3 && std::system("./ns3 build") != 0) {
+        std::cerr << "Error building the simulation." << std::endl;
+        return 1;
+    }
+
+    std::vector<BenchCase> cases;
+    std::vector<WorkerJob> jobs;
+    for (const auto& g : gNbNums)
+        for (const auto& u : ueNums)
+            for (const auto& n : numerologies)
+                for (const auto& b : bandwidths)
+                    for (const auto& s : schedulers) {
+                        BenchCase c;
+                        c.gNbNum = std::stoi(g);
+                        c.ueNumPergNb = std::stoi(u);
+                        c.numerology = std::stoi(n);
+                        c.bandwidth = std::stod(b);
+                        c.scheduler = s;
+                        // --repeat replications in one process: the peak RSS is
+                        // that of the process, the times are averaged
+                        std::string args = c.Args() + " --simTime=" + simTime +
+                                           " --replications=" + std::to_string(repeat);
+                        if (!extraArgs.empty()) {
+                            args += " " + extraArgs;
+                        }
+                        WorkerJob job;
+                        if (viaNs3) {
+                            job.command = "./ns3 run --no-build \"scratch/5GsimNS3/5Gmain.cc " + args + "\"";
+                        } else {
+                            job.command = program + " " + args;
+                        }
+                        cases.push_back(c);
+                        jobs.push_back(job);
+                    }
+
+    // One worker: concurrent runs would compete for cores and memory bandwidth
+    std::vector<int> timings(cases.size(), 0);
+    RunWorkerPool(
+        jobs, 1,
+        [&](size_t j, const std::string& line) {
+            ReplicationTiming t;
+            if (!ParseTimingLine(line.c_str(), t)) {
+                return;
+            }
+            BenchCase& c = cases[j];
+            c.setupSeconds += t.setupSeconds;
+            c.runSeconds += t.runSeconds;
+            c.simSeconds += t.simSeconds;
+            c.events += static_cast<double>(t.events);
+            ++timings[j];
+        },
+        [&](size_t j) {
+            BenchCase& c = cases[j];
+            if (timings[j] > 0) {
+                c.setupSeconds /= timings[j];
+                c.runSeconds /= timings[j];
+                c.simSeconds /= timings[j];
+                c.events /= timings[j];
+            }
+            c.ok = timings[j] == repeat;
+            c.peakRssKb = jobs[j].maxRssKb;
+            printf("[%zu/%zu] %s: setup %.3f s, run %.3f s, %.3f s/sim s, %.0f events/s, peak RSS %ld KiB%s\n",
+                   j + 1, jobs.size(), c.Args().c_str(), c.setupSeconds, c.runSeconds, c.WallPerSimSecond(),
+                   c.EventsPerSecond(), c.peakRssKb, c.ok ? "" : " (FAILED)");
+            fflush(stdout);
+        });
+
+    std::ofstream out(outPath);
+    if (!out) {
+        std::cerr << "Cannot open the output file " << outPath << std::endl;
+        return 1;
+    }
+    out << "{\n  \"benchmark\": \"5Gmain\",\n  \"simTime\": \"" << simTime << "\",\n  \"repeat\": " << repeat
+        << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < cases.size(); ++i) {
+        out << "    " << cases[i].Json() << (i + 1 < cases.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    out.close();
+    std::cout << "Results written to " << outPath << std::endl;
+
+    // Cases of one configuration are consecutive, in the order of --scheduler
+    if (schedulers.size() > 1) {
+        printf("Run time relative to --scheduler=%s:\n", schedulers[0].c_str());
+        for (size_t i = 0; i < cases.size(); i += schedulers.size()) {
+            const BenchCase& ref = cases[i];
+            printf("  gNbNum=%d ueNumPergNb=%d numerology=%d bandwidth=%g:", ref.gNbNum, ref.ueNumPergNb,
+                   ref.numerology, ref.bandwidth);
+            for (size_t k = 1; k < schedulers.size(); ++k) {
+                const BenchCase& c = cases[i + k];
+                if (ref.ok && c.ok && ref.runSeconds > 0.0) {
+                    printf(" %s %.2fx", c.scheduler.c_str(), c.runSeconds / ref.runSeconds);
+                } else {
+                    printf(" %s n/a", c.scheduler.c_str());
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    // A case regresses if it got slower or bigger than the baseline by more
+    // than the tolerance; tiny absolute differences are timer noise.
+    int regressions = 0;
+    if (!baselinePath.empty()) {
+        std::map<std::tuple<int, int, int, double, std::string>, BenchCase> baseline;
+        for (const BenchCase& c : LoadBaseline(baselinePath)) {
+            baseline[c.Key()] = c;
+        }
+        if (baseline.empty()) {
+            std::cerr << "No results in the baseline " << baselinePath << std::endl;
+            return 1;
+        }
+        for (const BenchCase& c : cases) {
+            auto it = baseline.find(c.Key());
+            if (it == baseline.end() || !it->second.ok) {
+                continue;
+            }
+            const BenchCase& b = it->second;
+            const struct {
+                const char* name;
+                double now;
+                double before;
+                double noise;
+            } metrics[] = {
+                {"wallPerSimSecond", c.WallPerSimSecond(), b.WallPerSimSecond(), 0.01},
+                {"setupSeconds", c.setupSeconds, b.setupSeconds, 0.01},
+                {"peakRssKb", static_cast<double>(c.peakRssKb), static_cast<double>(b.peakRssKb), 1024.0},
+            };
+            if (!c.ok) {
+                printf("REGRESSION %s: failed, the baseline passed\n", c.Args().c_str());
+                ++regressions;
+                continue;
+            }
+            for (const auto& m : metrics) {
+                if (m.now > m.before * (1.0 + tolerance) && m.now - m.before > m.noise) {
+                    printf("REGRESSION %s: %s %.6g -> %.6g (%+.1f%%)\n", c.Args().c_str(), m.name, m.before,
+                           m.now, 100.0 * (m.now / m.before - 1.0));
+                    ++regressions;
+                }
+            }
+        }
+        printf("%d regressions against %s (tolerance %.0f%%)\n", regressions, baselinePath.c_str(),
+               100.0 * tolerance);
+    }
+    return regressions > 0 ? 2 : 0;
+}
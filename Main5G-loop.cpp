@@ -1,95 +1,864 @@
 #include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <cstdlib>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <map>
 #include <regex>
-#include <random>
+#include <thread>
 #include <vector> // Include the vector header
+#include "online-stats.h"
+#include "philox-rng.h"
+#include "replication-result.h"
+#include "result-store.h"
+#include "spectral-efficiency.h"
+#include "telemetry-shm.h"
+#include "trace-record.h"
+#include "worker-pool.h"
 
-float random_pri() {
-    // Create a random number generator engine
-    std::random_device rd;   // Use a hardware random device if available
-    std::mt19937 gen(rd()); // Mersenne Twister engine for 32-bit integers
+/**
+ * One point of the parameter grid, i.e. one set of 5Gmain.cc command line
+ * values.
+ */
+struct SweepPoint {
+    std::string numerologyBwp1;
+    std::string centralFrequencyBand1;
+    std::string bandwidthBand1;
+    std::string packetSize;
+    std::string enableUl;
 
-    // Define a uniform distribution for floating-point values between 0.0 and 1.0
-    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    // Arguments passed to 5Gmain.cc for this point
+    std::string Args() const {
+        return "--numerologyBwp1=" + numerologyBwp1 + " --centralFrequencyBand1=" + centralFrequencyBand1 +
+               " --bandwidthBand1=" + bandwidthBand1 + " --packetSize=" + packetSize +
+               " --enableUl=" + enableUl;
+    }
+};
+
+// Metrics handed on to the optimizer, normalized to [0, 1]
+double NormalizedCv(const ReplicationResult& result) {
+    double maxCV = 130.0; // Maximum CV value
+    return (result.rssi + 120) / maxCV;
+}
 
-    // Generate and return a random value
-    return distribution(gen);
+double NormalizedSe(const ReplicationResult& result) {
+    double maxSE = 10.0; // Maximum SE value
+    return result.se / maxSE;
+}
+
+// Split a comma separated list of command line values
+std::vector<std::string> SplitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
 }
 
-int main() {
-    int numIterations;
+// Previous reading of a telemetry segment, to turn its counters into rates
+struct MonitorSample {
+    uint64_t run = 0;
+    uint64_t events = 0;
+    uint64_t nowTicks = 0;
+    uint64_t wallNs = 0;
+    uint64_t lastEventNs = 0; // wall time the event count last moved
+};
+
+// Print the telemetry segments of all simulations running on this host every
+// interval seconds, count times (0: until interrupted), as a table or as CSV.
+// A running replication whose event count has not moved for stallSeconds is
+// flagged STALLED; segments left by processes that died are flagged, and
+// removed with cleanup.
+int RunMonitor(double interval, int count, bool csv, double stallSeconds, bool cleanup) {
+    static const char* const stateNames[] = {"starting", "building", "running", "forking", "done"};
+    std::map<std::string, MonitorSample> last;
+    if (csv) {
+        printf("wall_s,pid,parent,state,run,done,replications,sim_s,stop_s,sim_per_wall,events,"
+               "events_per_s,queue,sinr,rssi,rlc,pdcp,position,flag\n");
+    }
+    for (int i = 0; count <= 0 || i < count; ++i) {
+        if (i > 0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+        }
+        const uint64_t now = TelemetryClockNs();
+        if (!csv) {
+            printf("\n%7s %7s %-8s %6s %9s %9s %6s %9s %11s %10s %9s %9s %9s %9s %9s  %s\n", "pid",
+                   "parent", "state", "run", "reps", "sim [s]", "done", "sim/wall", "events/s", "queue",
+                   "sinr", "rssi", "rlc", "pdcp", "position", "eta / flag");
+        }
+        std::map<std::string, MonitorSample> seen;
+        for (const std::string& name : TelemetryReader::List()) {
+            TelemetryReader reader;
+            if (!reader.Open(name)) {
+                continue;
+            }
+            const TelemetryCounters& c = reader.Counters();
+            const uint64_t state = c.state.load(std::memory_order_relaxed);
+            const bool alive = reader.WriterAlive();
+            const double tps = static_cast<double>(c.ticksPerSecond > 0 ? c.ticksPerSecond : 1);
+            MonitorSample sample;
+            sample.run = c.run.load(std::memory_order_relaxed);
+            sample.events = c.events.load(std::memory_order_relaxed);
+            sample.nowTicks = c.nowTicks.load(std::memory_order_relaxed);
+            sample.wallNs = now;
+            sample.lastEventNs = now;
+            const double sim = sample.nowTicks / tps;
+            const double stop = c.stopTicks.load(std::memory_order_relaxed) / tps;
+
+            // Rates over the last interval, or since the start of the run
+            // on the first reading
+            double speed = 0.0;
+            double eventRate = 0.0;
+            auto prev = last.find(name);
+            if (alive && state == TELEMETRY_RUNNING) {
+                if (prev != last.end() && prev->second.run == sample.run && prev->second.events <= sample.events) {
+                    const double dt = (now - prev->second.wallNs) / 1e9;
+                    speed = (sample.nowTicks - prev->second.nowTicks) / tps / dt;
+                    eventRate = (sample.events - prev->second.events) / dt;
+                    if (sample.events == prev->second.events) {
+                        sample.lastEventNs = prev->second.lastEventNs;
+                    }
+                } else {
+                    const double elapsed = (now - c.runStartNs.load(std::memory_order_relaxed)) / 1e9;
+                    speed = elapsed > 0.0 ? sim / elapsed : 0.0;
+                    eventRate = elapsed > 0.0 ? sample.events / elapsed : 0.0;
+                }
+            }
+
+            std::string flag;
+            if (!alive) {
+                flag = "DIED";
+                if (cleanup) {
+                    TelemetryReader::Remove(name);
+                    flag += " (removed)";
+                }
+            } else if (state == TELEMETRY_RUNNING && (now - sample.lastEventNs) / 1e9 >= stallSeconds) {
+                flag = "STALLED " + std::to_string(std::llround((now - sample.lastEventNs) / 1e9)) + " s";
+            } else if (state == TELEMETRY_RUNNING && speed > 0.0) {
+                flag = "eta " + std::to_string(static_cast<long long>(std::ceil((stop - sim) / speed))) + " s";
+            }
+            seen[name] = sample;
+
+            const char* stateName = state < 5 ? stateNames[state] : "?";
+            const unsigned long long done = c.replicationsDone.load(std::memory_order_relaxed);
+            const unsigned long long reps = c.replications.load(std::memory_order_relaxed);
+            const unsigned long long queue = c.pendingEvents.load(std::memory_order_relaxed);
+            unsigned long long callbacks[TELEMETRY_CALLBACK_SLOTS];
+            for (size_t k = 0; k < TELEMETRY_CALLBACK_SLOTS; ++k) {
+                callbacks[k] = c.callbacks[k].load(std::memory_order_relaxed);
+            }
+            if (csv) {
+                printf("%.3f,%d,%d,%s,%llu,%llu,%llu,%.6f,%.6f,%.6f,%llu,%.1f,%llu,%llu,%llu,%llu,%llu,%llu,%s\n",
+                       now / 1e9, c.pid, c.parentPid, stateName, static_cast<unsigned long long>(sample.run),
+                       done, reps, sim, stop, speed, static_cast<unsigned long long>(sample.events), eventRate,
+                       queue, callbacks[TRACE_SINR], callbacks[TRACE_RSSI], callbacks[TRACE_RLC_RX],
+                       callbacks[TRACE_PDCP_RX], callbacks[TRACE_POSITION], flag.c_str());
+            } else {
+                const std::string repsText = std::to_string(done) + "/" + std::to_string(reps);
+                printf("%7d %7d %-8s %6llu %9s %9.3f %5.1f%% %9.4f %11.0f %10llu %9llu %9llu %9llu %9llu %9llu  %s\n",
+                       c.pid, c.parentPid, stateName, static_cast<unsigned long long>(sample.run),
+                       repsText.c_str(), sim, stop > 0.0 ? 100.0 * sim / stop : 0.0, speed, eventRate, queue,
+                       callbacks[TRACE_SINR], callbacks[TRACE_RSSI], callbacks[TRACE_RLC_RX],
+                       callbacks[TRACE_PDCP_RX], callbacks[TRACE_POSITION], flag.c_str());
+            }
+        }
+        last.swap(seen);
+        fflush(stdout);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int numIterations = 0;
     std::vector<double> CV_a_5G;
     std::vector<double> UP_a_5G;
     std::vector<double> SE_a_5G;
 
+    // Parameter grid; every parameter accepts a comma separated list and the
+    // sweep runs the cartesian product. The defaults are those of 5Gmain.cc.
+    std::vector<std::string> numerologies{"0"};
+    std::vector<std::string> frequencies{"28e9"};
+    std::vector<std::string> bandwidths{"400e6"};
+    std::vector<std::string> packetSizes{"1000"};
+    std::vector<std::string> enableUls{"0"};
+    unsigned jobs = std::thread::hardware_concurrency();
+    int chunk = 0;
+    unsigned long long firstRun = 1;
+    unsigned seed = 1; // ns-3 RngSeed, 1 being its default
+    std::string program = "./ns3";
+    std::string traceDir;
+    std::string seModeName = "shannon";
+    bool forkReplications = false;
+    bool fastPath = false;
+    bool validateFastPath = false;
+    std::string scenarioArgs;
+    // Partitioned runs: strips of sites per run, each simulated by its own
+    // process without the interference of the other strips, and whether to
+    // measure the error this makes against the uncut scenario
+    int partitionProcs = 0;
+    bool validatePartitions = false;
+    std::string stopOn;
+    std::string quiescence;
+    std::string storePath;
+    // Sequential stopping on relative confidence interval half widths
+    double ciTargetCv = 0.0;
+    double ciTargetSe = 0.0;
+    double confidence = 0.95;
+    int minReplications = 10;
+    int maxReplications = 1000;
+    // Live telemetry: --telemetry makes the workers publish it, --monitor
+    // displays what every simulation on the host publishes
+    bool telemetry = false;
+    bool monitor = false;
+    double monitorInterval = 1.0;
+    int monitorCount = 0;
+    std::string monitorFormat = "table";
+    double stallSeconds = 30.0;
+    bool monitorCleanup = false;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+            std::cerr << "Unrecognized argument: " << arg << std::endl;
+            return 1;
+        }
+        std::string key = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+        if (key == "numerologyBwp1") {
+            numerologies = SplitList(value);
+        } else if (key == "centralFrequencyBand1") {
+            frequencies = SplitList(value);
+        } else if (key == "bandwidthBand1") {
+            bandwidths = SplitList(value);
+        } else if (key == "packetSize") {
+            packetSizes = SplitList(value);
+        } else if (key == "enableUl") {
+            enableUls = SplitList(value);
+        } else if (key == "replications") {
+            numIterations = std::stoi(value);
+        } else if (key == "jobs") {
+            jobs = std::stoul(value);
+        } else if (key == "chunk") {
+            chunk = std::stoi(value);
+        } else if (key == "firstRun") {
+            firstRun = std::stoull(value);
+        } else if (key == "seed") {
+            seed = std::stoul(value);
+        } else if (key == "program") {
+            program = value;
+        } else if (key == "traceDir") {
+            traceDir = value;
+        } else if (key == "seMode") {
+            seModeName = value;
+        } else if (key == "store") {
+            storePath = value;
+        } else if (key == "fork") {
+            forkReplications = value == "1" || value == "true";
+        } else if (key == "fastPath") {
+            fastPath = value == "1" || value == "true";
+        } else if (key == "stopOn") {
+            stopOn = value;
+        } else if (key == "quiescence") {
+            quiescence = value;
+        } else if (key == "ciTargetCv") {
+            ciTargetCv = std::stod(value);
+        } else if (key == "ciTargetSe") {
+            ciTargetSe = std::stod(value);
+        } else if (key == "confidence") {
+            confidence = std::stod(value);
+        } else if (key == "minReplications") {
+            minReplications = std::max(2, std::stoi(value));
+        } else if (key == "maxReplications") {
+            maxReplications = std::stoi(value);
+        } else if (key == "validateFastPath") {
+            validateFastPath = value == "1" || value == "true";
+        } else if (key == "scenarioArgs") {
+            scenarioArgs = value;
+        } else if (key == "partitionProcs") {
+            partitionProcs = std::stoi(value);
+        } else if (key == "validatePartitions") {
+            validatePartitions = value == "1" || value == "true";
+        } else if (key == "telemetry") {
+            telemetry = value == "1" || value == "true";
+        } else if (key == "monitor") {
+            monitor = value == "1" || value == "true";
+        } else if (key == "monitorInterval") {
+            monitorInterval = std::stod(value);
+        } else if (key == "monitorCount") {
+            monitorCount = std::stoi(value);
+        } else if (key == "monitorFormat") {
+            monitorFormat = value;
+        } else if (key == "stallSeconds") {
+            stallSeconds = std::stod(value);
+        } else if (key == "monitorCleanup") {
+            monitorCleanup = value == "1" || value == "true";
+        } else {
+            std::cerr << "Unrecognized argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (jobs == 0) {
+        jobs = 1;
+    }
+    if (monitor) {
+        if (monitorInterval <= 0.0 || (monitorFormat != "table" && monitorFormat != "csv")) {
+            std::cerr << "--monitor needs --monitorInterval > 0 and --monitorFormat table or csv" << std::endl;
+            return 1;
+        }
+        return RunMonitor(monitorInterval, monitorCount, monitorFormat == "csv", stallSeconds, monitorCleanup);
+    }
+    SeMode seMode;
+    if (!ParseSeMode(seModeName, seMode)) {
+        std::cerr << "Unknown --seMode " << seModeName << std::endl;
+        return 1;
+    }
+    // Validation compares full-stack runs with the predictions they print,
+    // which the result store does not keep
+    if (validateFastPath && (fastPath || !storePath.empty())) {
+        std::cerr << "--validateFastPath runs the full stack, without --fastPath or --store" << std::endl;
+        return 1;
+    }
+    if (fastPath && forkReplications) {
+        std::cerr << "--fastPath has no scenario to fork, drop --fork" << std::endl;
+        return 1;
+    }
+    // Only the process that has UE 0 traces its measurements
+    if (partitionProcs > 0 && (fastPath || forkReplications || !traceDir.empty())) {
+        std::cerr << "--partitionProcs runs the full stack of each strip, without --fastPath, --fork or "
+                     "--traceDir" << std::endl;
+        return 1;
+    }
+    // Validation needs both results of every run, so no store either
+    if (validatePartitions && (partitionProcs < 2 || validateFastPath || !storePath.empty())) {
+        std::cerr << "--validatePartitions needs --partitionProcs of at least 2, and no --validateFastPath "
+                     "or --store" << std::endl;
+        return 1;
+    }
+
+    // With CI targets, run between --minReplications and --maxReplications
+    const bool sequential = ciTargetCv > 0.0 || ciTargetSe > 0.0;
+    if (sequential) {
+        if (confidence <= 0.0 || confidence >= 1.0 || maxReplications < minReplications) {
+            std::cerr << "Need 0 < --confidence < 1 and --minReplications <= --maxReplications" << std::endl;
+            return 1;
+        }
+        numIterations = maxReplications;
+    }
+
     // Prompt the user for the number of iterations
-    std::cout << "Enter the number of iterations: ";
-    std::cin >> numIterations;
+    if (numIterations <= 0) {
+        std::cout << "Enter the number of iterations: ";
+        std::cin >> numIterations;
+    }
 
-    // The command to run
-    const char* command = "./ns3 run scratch/5GsimNS3/5Gmain.cc";
+    std::vector<SweepPoint> points;
+    for (const auto& numerology : numerologies)
+        for (const auto& frequency : frequencies)
+            for (const auto& bandwidth : bandwidths)
+                for (const auto& packetSize : packetSizes)
+                    for (const auto& enableUl : enableUls)
+                        points.push_back({numerology, frequency, bandwidth, packetSize, enableUl});
 
-    // Create a text file to save the RSSI, SE, and UE position values
-    std::ofstream outputFile("rssi_se_position.txt");
+    // Worker options that change the results, hence also the store keys.
+    // Early stop changes which samples are the last.
+    std::string resultArgs;
+    if (!stopOn.empty()) {
+        resultArgs = " --stopOn=" + stopOn + (quiescence.empty() ? "" : " --quiescence=" + quiescence);
+    }
+    // Only a non-default seed is passed on, so existing store keys stay valid
+    if (seed != 1) {
+        resultArgs += " --RngSeed=" + std::to_string(seed);
+    }
+    // e.g. "--layout=hex --gNbNum=19 --sectors=3"
+    if (!scenarioArgs.empty()) {
+        resultArgs += " " + scenarioArgs;
+    }
 
-    for (int i = 0; i < numIterations; ++i) {
-        std::cout << "Running iteration " << (i + 1) << "..." << std::endl;
+    // Build once up front: concurrent "./ns3 run" build checks would race
+    // with each other, so the workers run with --no-build.
+    const bool viaNs3 = program == "./ns3";
+    if (viaNs3 && std::system("./ns3 build") != 0) {
+        std::cerr << "Error building the simulation." << std::endl;
+        return 1;
+    }
 
-        // Execute the command using the system function and capture the output
-        FILE* pipe = popen(command, "r");
-        if (!pipe) {
-            std::cerr << "Error executing command." << std::endl;
+    // Every point runs the replications with RngRun firstRun, firstRun + 1,
+    // ..., split into chunks of consecutive runs, one worker process per
+    // chunk. Reusing the same runs for each point keeps the comparison
+    // between points on common random numbers.
+    // Results are stored by (point, replication) so that the merged output
+    // does not depend on the order in which the workers finish.
+    std::vector<std::vector<ReplicationResult>> results(points.size(),
+                                                        std::vector<ReplicationResult>(numIterations));
+    std::vector<std::vector<bool>> reported(points.size(), std::vector<bool>(numIterations, false));
+    // With --validateFastPath, the analytic prediction of each full-stack run
+    std::vector<std::vector<ReplicationResult>> predictions(validateFastPath ? points.size() : 0,
+                                                            std::vector<ReplicationResult>(numIterations));
+    std::vector<std::vector<bool>> predicted(validateFastPath ? points.size() : 0,
+                                             std::vector<bool>(numIterations, false));
+    // With --validatePartitions, the uncut run of each partitioned one
+    std::vector<std::vector<ReplicationResult>> references(validatePartitions ? points.size() : 0,
+                                                           std::vector<ReplicationResult>(numIterations));
+    std::vector<std::vector<bool>> referenced(validatePartitions ? points.size() : 0,
+                                              std::vector<bool>(numIterations, false));
+
+    // Runs found in the result store are taken from there. The key covers
+    // every option that changes what 5Gmain computes, but not the simulator
+    // itself: use a fresh store after changing 5Gmain.cc.
+    ResultStore store;
+    std::vector<std::string> scenarioKeys;
+    for (const auto& point : points) {
+        scenarioKeys.push_back(point.Args() + " --seMode=" + seModeName +
+                               (forkReplications ? " --forkReplications=1" : "") +
+                               (fastPath ? " --fastPath=1" : "") +
+                               (partitionProcs > 0 ? " --partitions=" + std::to_string(partitionProcs) : "") +
+                               resultArgs);
+    }
+    size_t stored = 0;
+    if (!storePath.empty()) {
+        if (!store.Open(storePath)) {
+            std::cerr << "Cannot open the result store " << storePath << std::endl;
             return 1;
         }
+        for (size_t p = 0; p < points.size(); ++p) {
+            for (int r = 0; r < numIterations; ++r) {
+                uint64_t key = ResultStore::MakeKey(scenarioKeys[p], firstRun + r);
+                if (store.Find(key, results[p][r])) {
+                    reported[p][r] = true;
+                    ++stored;
+                }
+            }
+        }
+        std::cout << "Result store: " << stored << " runs already done" << std::endl;
+    }
 
-        // Read the command output line by line
-        std::string line;
-        char buffer[128]; // Declare a buffer to read lines into
-        double rssiValue = 0.0; // Initialize RSSI value
-        double seValue = 0.0;   // Initialize SE value
-        std::string uePosition; // Initialize UE position as a string
+    // Replications each point should have: all of them with a fixed count;
+    // with CI targets, rounds grow it until the targets are met.
+    std::vector<int> wanted(points.size(), sequential ? std::min(minReplications, numIterations) : numIterations);
+    std::vector<bool> converged(points.size(), false);
+    const int fixedChunk = chunk;
+    int traceFiles = 0;
 
-        while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-            line = buffer;
+    for (int round = 1;; ++round) {
+        size_t toRun = 0;
+        for (size_t p = 0; p < points.size(); ++p) {
+            toRun += std::count(reported[p].begin(), reported[p].begin() + wanted[p], false);
+        }
 
-            // Check for lines containing RSSI, SE, and UE position values
-            if (line.find("RSSI: ") != std::string::npos) {
-                size_t rssiPos = line.find("RSSI: ") + 6;
-                rssiValue = std::stod(line.substr(rssiPos, line.find(" dBm", rssiPos) - rssiPos));
-            } else if (line.find("SE: ") != std::string::npos) {
-                size_t sePos = line.find("SE: ") + 4;
-                seValue = std::stod(line.substr(sePos, line.find(" bps/Hz", sePos) - sePos));
-            } else if (line.find("Position(") != std::string::npos) {
-                size_t startPos = line.find("Position(") + 9;
-                size_t endPos = line.find(")", startPos);
-                uePosition = line.substr(startPos, endPos - startPos);
+        // With --fork every worker builds the scenario once and forks its
+        // replications from it, so fewer, larger chunks amortize the setup
+        // better than the finer split used for load balancing otherwise.
+        chunk = fixedChunk;
+        if (chunk <= 0) {
+            size_t chunks = forkReplications ? jobs : 4 * jobs;
+            chunk = static_cast<int>((toRun + chunks - 1) / chunks);
+            chunk = std::max(1, std::min(chunk, numIterations));
+        }
+        struct ChunkInfo {
+            size_t point;
+            int firstReplication;
+            int count;
+            int trace;
+            bool reference; ///< the uncut reference of a partitioned chunk
+        };
+        std::vector<ChunkInfo> chunks;
+        std::vector<WorkerJob> workerJobs;
+        for (size_t p = 0; p < points.size(); ++p) {
+            for (int r = 0; r < wanted[p];) {
+                // Chunks cover consecutive runs that are not in the store yet
+                if (reported[p][r]) {
+                    ++r;
+                    continue;
+                }
+                int count = 1;
+                while (count < chunk && r + count < wanted[p] && !reported[p][r + count]) {
+                    ++count;
+                }
+                std::string args = points[p].Args() + " --replications=" + std::to_string(count) +
+                                   " --RngRun=" + std::to_string(firstRun + r) + " --seMode=" + seModeName;
+                if (forkReplications) {
+                    args += " --forkReplications=1 --forkJobs=1";
+                }
+                if (fastPath) {
+                    args += " --fastPath=1";
+                }
+                args += resultArgs;
+                if (validateFastPath) {
+                    args += " --fastPathCheck=1";
+                }
+                // Progress only, so not part of the store keys
+                if (telemetry) {
+                    args += " --telemetry=1";
+                }
+                int trace = -1;
+                if (!traceDir.empty()) {
+                    trace = traceFiles++;
+                    args += " --traceFile=" + traceDir + "/trace-" + std::to_string(trace) + ".bin";
+                }
+                // A partitioned chunk is one process per strip; only the one
+                // that has UE 0 reports the runs
+                const int processes = std::max(1, partitionProcs);
+                for (int k = 0; k < processes; ++k) {
+                    std::string processArgs = args;
+                    if (partitionProcs > 0) {
+                        processArgs += " --partitions=" + std::to_string(partitionProcs) +
+                                       " --partition=" + std::to_string(k);
+                    }
+                    WorkerJob job;
+                    if (viaNs3) {
+                        job.command = "./ns3 run --no-build \"scratch/5GsimNS3/5Gmain.cc " + processArgs + "\"";
+                    } else {
+                        job.command = program + " " + processArgs;
+                    }
+                    chunks.push_back({p, r, count, trace, false});
+                    workerJobs.push_back(job);
+                }
+                if (validatePartitions) {
+                    // The whole scenario in one process, measuring the same UE
+                    std::string referenceArgs = points[p].Args() + " --replications=" + std::to_string(count) +
+                                                " --RngRun=" + std::to_string(firstRun + r) +
+                                                " --seMode=" + seModeName + resultArgs + " --measureUe0=1";
+                    if (telemetry) {
+                        referenceArgs += " --telemetry=1";
+                    }
+                    WorkerJob reference;
+                    if (viaNs3) {
+                        reference.command = "./ns3 run --no-build \"scratch/5GsimNS3/5Gmain.cc " + referenceArgs + "\"";
+                    } else {
+                        reference.command = program + " " + referenceArgs;
+                    }
+                    chunks.push_back({p, r, count, -1, true});
+                    workerJobs.push_back(reference);
+                }
+                r += count;
             }
         }
 
-        pclose(pipe);
+        if (sequential) {
+            std::cout << "Round " << round << ": ";
+        }
+        std::cout << "Running up to " << *std::max_element(wanted.begin(), wanted.end())
+                  << " iterations for each of " << points.size() << " parameter points (" << toRun
+                  << " runs to do) on " << jobs << " workers..." << std::endl;
 
-        double UP = random_pri();
+        size_t finished = 0;
+        RunWorkerPool(
+            workerJobs, jobs,
+            [&](size_t j, const std::string& line) {
+                const ChunkInfo& info = chunks[j];
+                ReplicationResult result;
+                if (info.reference) {
+                    long long r = ParseResultLine(line.c_str(), result)
+                                      ? static_cast<long long>(result.run - firstRun) : -1;
+                    if (r >= info.firstReplication && r < info.firstReplication + info.count) {
+                        references[info.point][r] = result;
+                        referenced[info.point][r] = true;
+                    }
+                    return;
+                }
+                if (validateFastPath && ParseResultLine(line.c_str(), result, "PREDICTION")) {
+                    long long r = static_cast<long long>(result.run - firstRun);
+                    if (r >= info.firstReplication && r < info.firstReplication + info.count) {
+                        predictions[info.point][r] = result;
+                        predicted[info.point][r] = true;
+                    }
+                    return;
+                }
+                if (!ParseResultLine(line.c_str(), result)) {
+                    return;
+                }
+                long long r = static_cast<long long>(result.run - firstRun);
+                if (r >= info.firstReplication && r < info.firstReplication + info.count) {
+                    results[info.point][r] = result;
+                    reported[info.point][r] = true;
+                    // Stored as soon as it is reported, so a chunk that dies
+                    // later keeps its finished runs. With traces, the values
+                    // come from the trace file at the end of the chunk.
+                    if (!storePath.empty() && traceDir.empty()) {
+                        store.Add(ResultStore::MakeKey(scenarioKeys[info.point], firstRun + r), result);
+                    }
+                }
+            },
+            [&](size_t j) {
+                const ChunkInfo& info = chunks[j];
+                // With binary traces, take the measurements from the records: the
+                // last RSSI, SINR/SE and position of each run, as in the text output.
+                // The SE is recomputed from all SINR samples of the chunk in one
+                // batch, so a trace can be re-evaluated with another --seMode.
+                if (!traceDir.empty() && !info.reference) {
+                    TraceFileView trace;
+                    if (!trace.Open(traceDir + "/trace-" + std::to_string(info.trace) + ".bin")) {
+                        std::cerr << "Cannot read the trace of chunk " << j << std::endl;
+                        return;
+                    }
+                    std::vector<double> sinrSamples;
+                    std::vector<int> sinrReplication;
+                    for (const TraceRecord& record : trace) {
+                        long long r = static_cast<long long>(record.run) - static_cast<long long>(firstRun);
+                        if (r < info.firstReplication || r >= info.firstReplication + info.count) {
+                            continue;
+                        }
+                        ReplicationResult& result = results[info.point][r];
+                        switch (record.type) {
+                        case TRACE_RSSI:
+                            result.rssi = record.value[0];
+                            break;
+                        case TRACE_SINR:
+                            result.sinr = record.value[0];
+                            sinrSamples.push_back(record.value[0]);
+                            sinrReplication.push_back(static_cast<int>(r));
+                            break;
+                        case TRACE_POSITION:
+                            result.x = record.value[0];
+                            result.y = record.value[1];
+                            result.z = record.value[2];
+                            break;
+                        default:
+                            break;
+                        }
+                    }
+                    std::vector<double> seSamples(sinrSamples.size());
+                    SpectralEfficiencyBatch(sinrSamples.data(), seSamples.data(), sinrSamples.size(), seMode);
+                    for (size_t s = 0; s < seSamples.size(); ++s) {
+                        results[info.point][sinrReplication[s]].se = seSamples[s];
+                    }
+                }
+                if (!storePath.empty() && !traceDir.empty()) {
+                    for (int r = info.firstReplication; r < info.firstReplication + info.count; ++r) {
+                        if (reported[info.point][r]) {
+                            store.Add(ResultStore::MakeKey(scenarioKeys[info.point], firstRun + r),
+                                      results[info.point][r]);
+                        }
+                    }
+                }
+                std::cout << "Finished chunk " << ++finished << "/" << workerJobs.size() << std::endl;
+            });
 
-        ///////////////////// changing CV and SE to [0,1] //////////////////////////////////////////
-        double maxCV = 130.0; // Maximum CV value
-        double CV_5G = ((rssiValue + 120) / maxCV);
-        printf("CV_5G (check) = %f\n",CV_5G);
+        if (!sequential) {
+            break;
+        }
 
-        double maxSE = 10.0; // Maximum SE value
-        double SE_5G = ((seValue / maxSE));
-        printf("SE_5G (check) = %f\n",SE_5G);
+        // Sequential stopping: a point is done once the relative half width
+        // of the confidence interval of each targeted metric is within its
+        // target, or at --maxReplications. Otherwise the next round extends
+        // it to the count the current variance estimate asks for, at most
+        // doubling it, since that estimate is noisy with few samples.
+        bool done = true;
+        for (size_t p = 0; p < points.size(); ++p) {
+            if (converged[p]) {
+                continue;
+            }
+            OnlineStats cv, se;
+            for (int r = 0; r < wanted[p]; ++r) {
+                if (reported[p][r]) {
+                    cv.Add(NormalizedCv(results[p][r]));
+                    se.Add(NormalizedSe(results[p][r]));
+                }
+            }
+            const struct {
+                const OnlineStats& stats;
+                double target;
+            } metrics[] = {{cv, ciTargetCv}, {se, ciTargetSe}};
+            double needed = 0.0;
+            bool met = true;
+            for (const auto& m : metrics) {
+                if (m.target <= 0.0) {
+                    continue;
+                }
+                double halfWidth = m.stats.HalfWidth(confidence);
+                double allowed = m.target * std::abs(m.stats.Mean());
+                if (!(halfWidth <= allowed)) {
+                    met = false;
+                    // n grows with the square of the ratio of the widths
+                    double ratio = allowed > 0.0 ? halfWidth / allowed : 2.0;
+                    needed = std::max(needed, std::isfinite(ratio) ? m.stats.Count() * ratio * ratio : 2.0 * wanted[p]);
+                }
+            }
+            if (met || wanted[p] >= numIterations) {
+                converged[p] = true;
+                continue;
+            }
+            int next = static_cast<int>(std::ceil(needed));
+            wanted[p] = std::min(numIterations, std::max(wanted[p] + 1, std::min(next, 2 * wanted[p])));
+            done = false;
+        }
+        if (done) {
+            break;
+        }
+    }
 
-        CV_a_5G.push_back(CV_5G);
-        UP_a_5G.push_back(UP);
-        SE_a_5G.push_back(SE_5G);
+    // Create a text file to save the RSSI, SE, and UE position values
+    std::ofstream outputFile("rssi_se_position.txt");
 
-        std::cout << "RSSI: " << rssiValue << " dBm, SE: " << seValue << " bps/Hz, UE Position: " << uePosition << ", User priority = " << UP << std::endl;
+    size_t missing = 0;
+    for (size_t p = 0; p < points.size(); ++p) {
+        for (int i = 0; i < wanted[p]; ++i) {
+            if (!reported[p][i]) {
+                ++missing;
+                continue;
+            }
+            const ReplicationResult& result = results[p][i];
+            double rssiValue = result.rssi;
+            double seValue = result.se;
+            std::string uePosition = std::to_string(result.x) + ", " + std::to_string(result.y) + ", " +
+                                     std::to_string(result.z);
+
+            // Keyed by run like the UE positions, so the same replication
+            // gets the same priority at every point and in every chunking
+            double UP = PhiloxRng(seed, firstRun + i, PHILOX_STREAM_USER_PRIORITY).Uniform(0, 0);
+
+            ///////////////////// changing CV and SE to [0,1] //////////////////////////////////////////
+            double CV_5G = NormalizedCv(result);
+            printf("CV_5G (check) = %f\n",CV_5G);
+
+            double SE_5G = NormalizedSe(result);
+            printf("SE_5G (check) = %f\n",SE_5G);
+
+            CV_a_5G.push_back(CV_5G);
+            UP_a_5G.push_back(UP);
+            SE_a_5G.push_back(SE_5G);
+
+            std::cout << "RSSI: " << rssiValue << " dBm, SE: " << seValue << " bps/Hz, UE Position: " << uePosition << ", User priority = " << UP << std::endl;
+
+            // Write the captured values to the output file
+            outputFile << "Point [" << points[p].Args() << "] Iteration " << (i + 1) << ": RSSI = " << rssiValue << " dBm, SE = " << seValue << " bps/Hz, UE Position = " << uePosition << ", User priority = " << UP << std::endl;
+        }
+    }
+
+    if (missing > 0) {
+        std::cerr << missing << " iterations did not report a result." << std::endl;
+    }
+
+    if (sequential) {
+        printf("Confidence intervals at %.1f%%:\n", 100.0 * confidence);
+        for (size_t p = 0; p < points.size(); ++p) {
+            OnlineStats cv, se;
+            for (int r = 0; r < wanted[p]; ++r) {
+                if (reported[p][r]) {
+                    cv.Add(NormalizedCv(results[p][r]));
+                    se.Add(NormalizedSe(results[p][r]));
+                }
+            }
+            double cvRel = cv.HalfWidth(confidence) / std::abs(cv.Mean());
+            double seRel = se.HalfWidth(confidence) / std::abs(se.Mean());
+            bool met = (ciTargetCv <= 0.0 || cvRel <= ciTargetCv) && (ciTargetSe <= 0.0 || seRel <= ciTargetSe);
+            printf("  [%s] n=%llu CV_5G %.6f +- %.6f (%.2f%%) SE_5G %.6f +- %.6f (%.2f%%)%s\n",
+                   points[p].Args().c_str(), static_cast<unsigned long long>(cv.Count()), cv.Mean(),
+                   cv.HalfWidth(confidence), 100.0 * cvRel, se.Mean(), se.HalfWidth(confidence), 100.0 * seRel,
+                   met ? "" : " (target not met at --maxReplications)");
+        }
+    }
+
+    // Error of the fast path against the full stack, on the same geometry.
+    // Runs without DL data have no SINR to compare.
+    if (validateFastPath) {
+        for (size_t p = 0; p < points.size(); ++p) {
+            OnlineStats rssiError, sinrError, seError;
+            int agree = 0;
+            int compared = 0;
+            for (int i = 0; i < numIterations; ++i) {
+                if (!reported[p][i] || !predicted[p][i]) {
+                    continue;
+                }
+                const ReplicationResult& full = results[p][i];
+                const ReplicationResult& fast = predictions[p][i];
+                ++compared;
+                agree += full.delivered == fast.delivered ? 1 : 0;
+                rssiError.Add(std::abs(fast.rssi - full.rssi));
+                if (full.sinr > 0.0) {
+                    sinrError.Add(std::abs(10.0 * std::log10(fast.sinr / full.sinr)));
+                    seError.Add(std::abs(fast.se - full.se));
+                }
+            }
+            printf("Fast path vs full stack [%s], %d runs:\n", points[p].Args().c_str(), compared);
+            if (compared == 0) {
+                continue;
+            }
+            printf("  RSSI |error| mean %.3f dB, max %.3f dB\n", rssiError.Mean(), rssiError.Max());
+            if (sinrError.Count() > 0) {
+                printf("  SINR |error| mean %.3f dB, max %.3f dB (%llu runs with DL SINR)\n", sinrError.Mean(),
+                       sinrError.Max(), static_cast<unsigned long long>(sinrError.Count()));
+                printf("  SE   |error| mean %.4f bps/Hz, max %.4f bps/Hz\n", seError.Mean(), seError.Max());
+            }
+            printf("  delivery agrees in %d/%d runs\n", agree, compared);
+        }
+    }
 
-        // Write the captured values to the output file
-        outputFile << "Iteration " << (i + 1) << ": RSSI = " << rssiValue << " dBm, SE = " << seValue << " bps/Hz, UE Position = " << uePosition << ", User priority = " << UP << std::endl;
+    // Partitioned runs against the uncut scenario measuring the same UE: the
+    // position of UE 0 and the delivery must match exactly. The radio
+    // measurements differ by the interference of the other strips, which
+    // the partitioned runs leave out, and by their fading samples; the
+    // error is the mean of the per-run differences, which must be 0 within
+    // its confidence interval. A run and its reference share the RngRun and
+    // the position of UE 0, i.e. they are paired samples.
+    if (validatePartitions) {
+        for (size_t p = 0; p < points.size(); ++p) {
+            OnlineStats rssi[2], sinr[2], se[2];
+            OnlineStats rssiError, sinrError, seError;
+            double rssiMax = 0.0, sinrMax = 0.0, seMax = 0.0;
+            int samePosition = 0;
+            int sameDelivery = 0;
+            int compared = 0;
+            for (int i = 0; i < wanted[p]; ++i) {
+                if (!reported[p][i] || !referenced[p][i]) {
+                    continue;
+                }
+                const ReplicationResult* run[2] = {&results[p][i], &references[p][i]};
+                ++compared;
+                samePosition += run[0]->x == run[1]->x && run[0]->y == run[1]->y && run[0]->z == run[1]->z;
+                sameDelivery += run[0]->delivered == run[1]->delivered;
+                for (int k = 0; k < 2; ++k) {
+                    rssi[k].Add(run[k]->rssi);
+                    if (run[k]->sinr > 0.0) {
+                        sinr[k].Add(10.0 * std::log10(run[k]->sinr));
+                        se[k].Add(run[k]->se);
+                    }
+                }
+                rssiError.Add(run[0]->rssi - run[1]->rssi);
+                rssiMax = std::max(rssiMax, std::abs(run[0]->rssi - run[1]->rssi));
+                if (run[0]->sinr > 0.0 && run[1]->sinr > 0.0) {
+                    double sinrDb = 10.0 * std::log10(run[0]->sinr / run[1]->sinr);
+                    sinrError.Add(sinrDb);
+                    sinrMax = std::max(sinrMax, std::abs(sinrDb));
+                    seError.Add(run[0]->se - run[1]->se);
+                    seMax = std::max(seMax, std::abs(run[0]->se - run[1]->se));
+                }
+            }
+            bool ok = compared > 0 && samePosition == compared && sameDelivery == compared;
+            printf("Partitioned vs uncut [%s], %d runs in %d strips:\n", points[p].Args().c_str(), compared,
+                   partitionProcs);
+            printf("  UE 0 position identical in %d/%d runs, delivery in %d/%d runs\n", samePosition, compared,
+                   sameDelivery, compared);
+            const struct {
+                const char* name;
+                const OnlineStats* stats;
+                const OnlineStats* errors;
+                double maxError;
+            } metrics[] = {{"RSSI [dBm]", rssi, &rssiError, rssiMax}, {"SINR [dB] ", sinr, &sinrError, sinrMax},
+                           {"SE [bps/Hz]", se, &seError, seMax}};
+            for (const auto& m : metrics) {
+                double error = m.errors->Mean();
+                double halfWidth = m.errors->HalfWidth(confidence);
+                // Identical samples have no spread, and no error either;
+                // fewer than 2 pairs give no interval, which is a failure
+                bool agree = std::isfinite(halfWidth) && (std::abs(error) <= halfWidth || error == 0.0);
+                ok = ok && agree;
+                printf("  %s partitioned %.4f, uncut %.4f, error %.4f +- %.4f (max %.4f) over %llu pairs%s\n",
+                       m.name, m.stats[0].Mean(), m.stats[1].Mean(), error, halfWidth, m.maxError,
+                       static_cast<unsigned long long>(m.errors->Count()),
+                       agree ? "" : std::isfinite(halfWidth) ? " DIFFERS" : " TOO FEW PAIRS");
+            }
+            printf("  %s\n", ok ? "OK" : "MISMATCH");
+        }
     }
 
     std::ofstream dataFilewifiall("data_5G-raw.txt");
@@ -98,7 +867,7 @@ int main() {
         std::cerr << "Cannot open the output file!" << std::endl;
         return 1;
     }
-    for (size_t i = 0; i < numIterations; ++i) {
+    for (size_t i = 0; i < CV_a_5G.size(); ++i) {
         dataFilewifiall << CV_a_5G[i] << " " << UP_a_5G[i] << " " << SE_a_5G[i] << "\n";
     }
 
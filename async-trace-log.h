@@ -0,0 +1,230 @@
+#ifndef ASYNC_TRACE_LOG_H
+#define ASYNC_TRACE_LOG_H
+
+#include "spsc-ring.h"
+#include "trace-record.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Format \p record the way 5Gmain.cc prints its traces in text mode.
+ * @return the number of characters written to \p buf, at most size - 1.
+ */
+inline int
+FormatTraceRecordText(const TraceRecord& record, char* buf, std::size_t size)
+{
+    int n = 0;
+    switch (record.type)
+    {
+    case TRACE_SINR:
+        // value[0] is the linear SINR
+        n = std::snprintf(buf,
+                          size,
+                          "CellId: %u,\n RNTI: %u,\n SINR: %lf dB,\n SE: %lf bps/Hz\n",
+                          record.cellId,
+                          record.rnti,
+                          10.0 * std::log10(record.value[0]),
+                          record.value[1]);
+        break;
+    case TRACE_RSSI:
+        n = std::snprintf(buf, size, "RSSI: %g dBm\n", record.value[0]);
+        break;
+    case TRACE_RLC_RX:
+        n = std::snprintf(buf,
+                          size,
+                          "\n\n Data received at RLC layer at:+%lldns\n\n rnti:%u\n\n lcid:%u\n\n "
+                          "bytes :%u\n\n delay :%.0f\n",
+                          static_cast<long long>(record.timeNs),
+                          record.rnti,
+                          record.bwpId,
+                          record.aux,
+                          record.value[0]);
+        break;
+    case TRACE_PDCP_RX:
+        n = std::snprintf(buf, size, "\n Packet PDCP delay:%.0f\n", record.value[0]);
+        break;
+    case TRACE_POSITION:
+        n = std::snprintf(buf,
+                          size,
+                          "Node %u: Position(%g, %g, %g)\n",
+                          record.aux,
+                          record.value[0],
+                          record.value[1],
+                          record.value[2]);
+        break;
+    default:
+        break;
+    }
+    if (n < 0)
+    {
+        return 0;
+    }
+    return n < static_cast<int>(size) ? n : static_cast<int>(size) - 1;
+}
+
+/**
+ * \brief Trace output drained by a background thread.
+ *
+ * The simulation thread pushes fixed-size TraceRecords into an SpscRing,
+ * which costs a copy and a release store and never a system call. A
+ * background thread pops them in batches and either appends them to a
+ * binary TraceFileWriter or formats them as text to stdout. When the ring
+ * is full the producer waits for the consumer (BLOCK) or drops the record
+ * and counts it (DROP).
+ *
+ * A thread does not survive fork(), so the log is started and stopped
+ * around each Simulator::Run rather than once per process.
+ */
+class AsyncTraceLog
+{
+  public:
+    /// What Push does when the ring is full
+    enum Backpressure
+    {
+        BLOCK, ///< wait for the consumer; nothing is lost
+        DROP,  ///< discard the record and count it
+    };
+
+    /**
+     * @param capacity Ring capacity in records (rounded up to a power of two)
+     */
+    explicit AsyncTraceLog(std::size_t capacity = 1 << 16)
+        : m_ring(capacity)
+    {
+    }
+
+    ~AsyncTraceLog()
+    {
+        Stop();
+    }
+
+    AsyncTraceLog(const AsyncTraceLog&) = delete;
+    AsyncTraceLog& operator=(const AsyncTraceLog&) = delete;
+
+    void SetBackpressure(Backpressure backpressure)
+    {
+        m_backpressure = backpressure;
+    }
+
+    /**
+     * Start the consumer thread.
+     * @param writer Binary output, or nullptr to print text to stdout. The
+     * writer must not be used by anyone else until Stop returns.
+     */
+    void Start(TraceFileWriter* writer)
+    {
+        Stop();
+        m_writer = writer;
+        m_dropped = 0;
+        m_stop.store(false, std::memory_order_relaxed);
+        m_thread = std::thread(&AsyncTraceLog::Consume, this);
+    }
+
+    bool IsRunning() const
+    {
+        return m_thread.joinable();
+    }
+
+    /// Producer side, called from the simulation thread only
+    void Push(const TraceRecord& record)
+    {
+        if (m_ring.TryPush(record))
+        {
+            return;
+        }
+        if (m_backpressure == DROP)
+        {
+            ++m_dropped;
+            return;
+        }
+        while (!m_ring.TryPush(record))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Drain the ring, flush the output and join the consumer thread.
+     * @return the number of records dropped since Start.
+     */
+    uint64_t Stop()
+    {
+        if (m_thread.joinable())
+        {
+            m_stop.store(true, std::memory_order_release);
+            m_thread.join();
+        }
+        return m_dropped;
+    }
+
+  private:
+    void Consume()
+    {
+        const std::size_t batchSize = 1024;
+        std::vector<TraceRecord> batch(batchSize);
+        std::string text;
+        char line[512];
+        auto idleSleep = std::chrono::microseconds(50);
+        while (true)
+        {
+            // Read the flag before popping, so that everything pushed
+            // before Stop is seen by the last pass
+            bool stopping = m_stop.load(std::memory_order_acquire);
+            std::size_t n = m_ring.PopBatch(batch.data(), batchSize);
+            if (n == 0)
+            {
+                if (stopping)
+                {
+                    break;
+                }
+                // Poll with a growing sleep instead of waking the consumer
+                // from the producer, which would cost a syscall per record
+                std::this_thread::sleep_for(idleSleep);
+                idleSleep = std::min(idleSleep * 2, std::chrono::microseconds(2000));
+                continue;
+            }
+            idleSleep = std::chrono::microseconds(50);
+            if (m_writer != nullptr)
+            {
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    m_writer->Append(batch[i]);
+                }
+            }
+            else
+            {
+                text.clear();
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    text.append(line, FormatTraceRecordText(batch[i], line, sizeof(line)));
+                }
+                std::fwrite(text.data(), 1, text.size(), stdout);
+            }
+        }
+        if (m_writer != nullptr)
+        {
+            m_writer->Flush();
+        }
+        else
+        {
+            std::fflush(stdout);
+        }
+    }
+
+    SpscRing<TraceRecord> m_ring;
+    Backpressure m_backpressure{BLOCK};
+    TraceFileWriter* m_writer{nullptr};
+    uint64_t m_dropped{0}; ///< only touched by the producer
+    std::atomic<bool> m_stop{false};
+    std::thread m_thread;
+};
+
+#endif // ASYNC_TRACE_LOG_H
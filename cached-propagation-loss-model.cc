@@ -0,0 +1,285 @@
+#include "cached-propagation-loss-model.h"
+
+#include "ns3/abort.h"
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/mobility-model.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("CachedPropagationLossModel");
+
+NS_OBJECT_ENSURE_REGISTERED(CachedPropagationLossModel);
+
+namespace
+{
+
+/// Layout of the cache file header
+struct PathlossCacheFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    double binSize;
+    double frequency;
+    uint64_t count;
+};
+
+/// One entry of the cache file
+struct PathlossCacheFileEntry
+{
+    PathlossCache::Key key;
+    double lossDb;
+};
+
+const char PATHLOSS_CACHE_MAGIC[8] = {'5', 'G', 'P', 'L', 'C', 'A', 'C', 'H'};
+const uint32_t PATHLOSS_CACHE_VERSION = 1;
+
+/**
+ * Steepest distance dependence of the 3GPP TR 38.901 pathloss formulas,
+ * 40 log10(d): the loss changes by at most MAX_PATHLOSS_SLOPE / d dB per
+ * metre at distance d.
+ */
+const double MAX_PATHLOSS_SLOPE = 40.0 / std::log(10.0);
+
+} // namespace
+
+PathlossCache::PathlossCache(double binSize, double frequency)
+    : m_binSize(binSize),
+      m_frequency(frequency)
+{
+    NS_ABORT_MSG_IF(binSize <= 0.0, "The bin size of a pathloss cache must be positive");
+}
+
+PathlossCache::Key
+PathlossCache::MakeKey(const Vector& a, const Vector& b) const
+{
+    // The 3GPP models identify the gNB as the higher node, so key the link
+    // from that node's point of view; DL and UL then share the entries.
+    const Vector& high = a.z >= b.z ? a : b;
+    const Vector& low = a.z >= b.z ? b : a;
+    Key key;
+    key.dx = static_cast<int32_t>(std::lround((low.x - high.x) / m_binSize));
+    key.dy = static_cast<int32_t>(std::lround((low.y - high.y) / m_binSize));
+    key.hHigh = static_cast<int32_t>(std::lround(high.z / m_binSize));
+    key.hLow = static_cast<int32_t>(std::lround(low.z / m_binSize));
+    return key;
+}
+
+bool
+PathlossCache::Lookup(const Key& key, double& lossDb)
+{
+    auto it = m_table.find(key);
+    if (it == m_table.end())
+    {
+        ++m_misses;
+        return false;
+    }
+    ++m_hits;
+    lossDb = it->second;
+    return true;
+}
+
+void
+PathlossCache::Insert(const Key& key, double lossDb)
+{
+    m_table.emplace(key, lossDb);
+}
+
+double
+PathlossCache::GetBinSize() const
+{
+    return m_binSize;
+}
+
+std::size_t
+PathlossCache::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return 0;
+    }
+    PathlossCacheFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, PATHLOSS_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PATHLOSS_CACHE_VERSION ||
+        header.entrySize != sizeof(PathlossCacheFileEntry))
+    {
+        NS_LOG_WARN("Ignoring " << path << ": not a pathloss cache file");
+        return 0;
+    }
+    if (header.binSize != m_binSize || header.frequency != m_frequency)
+    {
+        NS_LOG_WARN("Ignoring " << path << ": written for bin size " << header.binSize
+                                << " m and frequency " << header.frequency << " Hz");
+        return 0;
+    }
+    std::size_t loaded = 0;
+    PathlossCacheFileEntry entry;
+    while (loaded < header.count && file.read(reinterpret_cast<char*>(&entry), sizeof(entry)))
+    {
+        m_table.emplace(entry.key, entry.lossDb);
+        ++loaded;
+    }
+    return loaded;
+}
+
+bool
+PathlossCache::Save(const std::string& path) const
+{
+    // Write to a temporary file and rename it, so that a concurrent reader
+    // or a crash never sees a partial cache
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+        PathlossCacheFileHeader header;
+        std::memcpy(header.magic, PATHLOSS_CACHE_MAGIC, sizeof(header.magic));
+        header.version = PATHLOSS_CACHE_VERSION;
+        header.entrySize = sizeof(PathlossCacheFileEntry);
+        header.binSize = m_binSize;
+        header.frequency = m_frequency;
+        header.count = m_table.size();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& item : m_table)
+        {
+            PathlossCacheFileEntry entry{item.first, item.second};
+            file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        }
+        if (!file)
+        {
+            return false;
+        }
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+std::size_t
+PathlossCache::GetSize() const
+{
+    return m_table.size();
+}
+
+uint64_t
+PathlossCache::GetHits() const
+{
+    return m_hits;
+}
+
+uint64_t
+PathlossCache::GetMisses() const
+{
+    return m_misses;
+}
+
+std::size_t
+PathlossCache::KeyHash::operator()(const Key& k) const
+{
+    uint64_t h = static_cast<uint32_t>(k.dx);
+    h = h * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(k.dy);
+    h = h * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(k.hHigh);
+    h = h * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(k.hLow);
+    return static_cast<std::size_t>(h ^ (h >> 29));
+}
+
+TypeId
+CachedPropagationLossModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::CachedPropagationLossModel")
+            .SetParent<PropagationLossModel>()
+            .AddConstructor<CachedPropagationLossModel>()
+            .AddAttribute("MaxErrorDb",
+                          "Largest error in dB that quantizing a link to the cache grid may "
+                          "introduce. Links too short to meet it are computed exactly.",
+                          DoubleValue(0.5),
+                          MakeDoubleAccessor(&CachedPropagationLossModel::m_maxErrorDb),
+                          MakeDoubleChecker<double>(0.0));
+    return tid;
+}
+
+CachedPropagationLossModel::CachedPropagationLossModel()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+CachedPropagationLossModel::~CachedPropagationLossModel()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+CachedPropagationLossModel::SetWrappedModel(Ptr<PropagationLossModel> model)
+{
+    m_wrapped = model;
+}
+
+void
+CachedPropagationLossModel::SetCache(std::shared_ptr<PathlossCache> cache)
+{
+    m_cache = cache;
+}
+
+Ptr<CachedPropagationLossModel>
+CachedPropagationLossModel::Install(Ptr<SpectrumChannel> channel,
+                                    std::shared_ptr<PathlossCache> cache,
+                                    double maxErrorDb)
+{
+    Ptr<CachedPropagationLossModel> cached = CreateObject<CachedPropagationLossModel>();
+    cached->SetAttribute("MaxErrorDb", DoubleValue(maxErrorDb));
+    cached->SetWrappedModel(channel->GetPropagationLossModel());
+    cached->SetCache(cache);
+    // AddPropagationLossModel chains the previous head behind the new
+    // model; the cache calls the wrapped model itself, so cut the chain.
+    channel->AddPropagationLossModel(cached);
+    cached->SetNext(nullptr);
+    return cached;
+}
+
+double
+CachedPropagationLossModel::DoCalcRxPower(double txPowerDbm,
+                                          Ptr<MobilityModel> a,
+                                          Ptr<MobilityModel> b) const
+{
+    NS_ASSERT_MSG(m_wrapped, "No model to cache");
+    Vector pa = a->GetPosition();
+    Vector pb = b->GetPosition();
+
+    // Two links in the same bin are at most sqrt(6) bins apart (the height
+    // difference spans two bins), which bounds the loss difference by the
+    // steepest pathloss slope over that distance.
+    double binSize = m_cache->GetBinSize();
+    double spread = std::sqrt(6.0) * binSize;
+    double distance = CalculateDistance(pa, pb);
+    if (distance <= spread || MAX_PATHLOSS_SLOPE * spread / (distance - spread) > m_maxErrorDb)
+    {
+        return m_wrapped->CalcRxPower(txPowerDbm, a, b);
+    }
+
+    PathlossCache::Key key = m_cache->MakeKey(pa, pb);
+    double lossDb;
+    if (!m_cache->Lookup(key, lossDb))
+    {
+        lossDb = -m_wrapped->CalcRxPower(0.0, a, b);
+        m_cache->Insert(key, lossDb);
+    }
+    return txPowerDbm - lossDb;
+}
+
+int64_t
+CachedPropagationLossModel::DoAssignStreams(int64_t stream)
+{
+    return m_wrapped ? m_wrapped->AssignStreams(stream) : 0;
+}
+
+} // namespace ns3
@@ -0,0 +1,144 @@
+#ifndef CACHED_PROPAGATION_LOSS_MODEL_H
+#define CACHED_PROPAGATION_LOSS_MODEL_H
+
+#include "ns3/propagation-loss-model.h"
+#include "ns3/spectrum-channel.h"
+#include "ns3/vector.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace ns3
+{
+
+/**
+ * \brief Table of pathloss values keyed by quantized link geometry.
+ *
+ * A link is described by the horizontal offset of the lower node (the UE)
+ * from the higher one (the gNB) and by the two antenna heights, each
+ * quantized to a bin of fixed size. The table is independent of any
+ * simulation, so it can be shared by all replications of a process and
+ * saved to disk to warm-start later runs.
+ */
+class PathlossCache
+{
+  public:
+    /**
+     * \param binSize Size of a quantization bin [m]
+     * \param frequency Carrier frequency the losses belong to [Hz]
+     */
+    PathlossCache(double binSize, double frequency);
+
+    /// Quantized link geometry
+    struct Key
+    {
+        int32_t dx;      ///< horizontal offset, x [bins]
+        int32_t dy;      ///< horizontal offset, y [bins]
+        int32_t hHigh;   ///< height of the higher node [bins]
+        int32_t hLow;    ///< height of the lower node [bins]
+
+        bool operator==(const Key& o) const
+        {
+            return dx == o.dx && dy == o.dy && hHigh == o.hHigh && hLow == o.hLow;
+        }
+    };
+
+    /// Key of the link between two positions
+    Key MakeKey(const Vector& a, const Vector& b) const;
+
+    /**
+     * \param key The link
+     * \param lossDb Set to the cached loss if found
+     * \return true on a hit
+     */
+    bool Lookup(const Key& key, double& lossDb);
+
+    void Insert(const Key& key, double lossDb);
+
+    double GetBinSize() const;
+
+    /**
+     * Merge the entries of a file written by Save. Files written for a
+     * different bin size or frequency are ignored.
+     * \return the number of entries loaded
+     */
+    std::size_t Load(const std::string& path);
+
+    /// \return false if the file could not be written
+    bool Save(const std::string& path) const;
+
+    std::size_t GetSize() const;
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+
+  private:
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& k) const;
+    };
+
+    double m_binSize;
+    double m_frequency;
+    std::unordered_map<Key, double, KeyHash> m_table;
+    uint64_t m_hits{0};
+    uint64_t m_misses{0};
+};
+
+/**
+ * \brief Decorator that serves the loss of a wrapped model from a
+ * PathlossCache.
+ *
+ * Only suitable for deterministic pathloss, i.e. with shadowing disabled
+ * and a fixed channel condition, as in the UMi StreetCanyon LoS scenario.
+ * Links that are so short that quantizing them could move the loss by more
+ * than MaxErrorDb bypass the cache and are computed exactly.
+ *
+ * This is the cheap part of the channel. The ThreeGppChannelModel matrices,
+ * which dominate, are not cached: their small-scale fading is drawn from
+ * the streams of each replication, and with UpdatePeriod 0 each link's
+ * matrix is already generated only once per replication. The
+ * DirectPathBeamforming vectors only depend on the geometry, but they are a
+ * closed-form phase per antenna element, far cheaper than a lookup keyed on
+ * the arrays would save. No speedup of the whole run has been measured.
+ */
+class CachedPropagationLossModel : public PropagationLossModel
+{
+  public:
+    static TypeId GetTypeId();
+
+    CachedPropagationLossModel();
+    ~CachedPropagationLossModel() override;
+
+    /// \param model The model whose losses are cached
+    void SetWrappedModel(Ptr<PropagationLossModel> model);
+
+    /// \param cache The table to use; may be shared with other instances
+    void SetCache(std::shared_ptr<PathlossCache> cache);
+
+    /**
+     * Replace the head of the loss chain of \p channel with a cache of it.
+     * \param channel The spectrum channel
+     * \param cache The table to use
+     * \param maxErrorDb Error bound, see the MaxErrorDb attribute
+     * \return the installed model
+     */
+    static Ptr<CachedPropagationLossModel> Install(Ptr<SpectrumChannel> channel,
+                                                   std::shared_ptr<PathlossCache> cache,
+                                                   double maxErrorDb);
+
+  private:
+    double DoCalcRxPower(double txPowerDbm,
+                         Ptr<MobilityModel> a,
+                         Ptr<MobilityModel> b) const override;
+    int64_t DoAssignStreams(int64_t stream) override;
+
+    Ptr<PropagationLossModel> m_wrapped;
+    std::shared_ptr<PathlossCache> m_cache;
+    double m_maxErrorDb;
+};
+
+} // namespace ns3
+
+#endif // CACHED_PROPAGATION_LOSS_MODEL_H
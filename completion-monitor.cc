@@ -0,0 +1,98 @@
+#include "completion-monitor.h"
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include <sstream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("CompletionMonitor");
+
+bool
+CompletionMonitor::ParseMeasurements(const std::string& list, uint32_t& mask)
+{
+    static const struct
+    {
+        const char* name;
+        Measurement measurement;
+    } names[] = {
+        {"pdcp", PDCP},
+        {"rlc", RLC},
+        {"sinr", SINR},
+        {"rssi", RSSI},
+        {"position", POSITION},
+    };
+
+    mask = 0;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        bool found = false;
+        for (const auto& n : names)
+        {
+            if (item == n.name)
+            {
+                mask |= n.measurement;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+CompletionMonitor::Start(uint32_t required, Time quiescence)
+{
+    m_required = required;
+    m_seen = 0;
+    m_quiescence = quiescence;
+    m_stopEvent = EventId();
+    m_complete = false;
+}
+
+bool
+CompletionMonitor::IsComplete() const
+{
+    return m_complete;
+}
+
+void
+CompletionMonitor::Seen(Measurement measurement)
+{
+    m_seen |= measurement;
+    if (m_complete || m_seen != m_required)
+    {
+        return;
+    }
+    if (m_quiescence.IsStrictlyPositive())
+    {
+        m_stopEvent.Cancel();
+        m_stopEvent = Simulator::Schedule(m_quiescence, &CompletionMonitor::Expire, this);
+    }
+    else
+    {
+        Expire();
+    }
+}
+
+void
+CompletionMonitor::Expire()
+{
+    NS_LOG_INFO("All required measurements collected at " << Simulator::Now().As(Time::S));
+    m_complete = true;
+    // Stops after the current event, ahead of the timeout
+    Simulator::Stop();
+}
+
+} // namespace ns3
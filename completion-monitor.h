@@ -0,0 +1,81 @@
+#ifndef COMPLETION_MONITOR_H
+#define COMPLETION_MONITOR_H
+
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+
+#include <cstdint>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * \brief Stops the simulation once a replication has collected what it
+ * needs.
+ *
+ * The trace callbacks report each measurement with Notify. When every
+ * required kind has been seen, the monitor stops the simulator, either at
+ * once or after a quiescence window without further required events; each
+ * required event restarts the window, so the last values of a burst are
+ * still collected. The stop time given to Simulator::Stop remains as the
+ * timeout for replications that never complete.
+ *
+ * Periodic events, such as the RSSI of every processed chunk, keep
+ * restarting the window: require them only without one.
+ */
+class CompletionMonitor
+{
+  public:
+    /// Kinds of measurement, as a bit mask
+    enum Measurement : uint32_t
+    {
+        PDCP = 1 << 0,     ///< PDCP PDU received
+        RLC = 1 << 1,      ///< RLC PDU received
+        SINR = 1 << 2,     ///< DL data SINR reported
+        RSSI = 1 << 3,     ///< RSSI reported
+        POSITION = 1 << 4, ///< UE position logged
+    };
+
+    /**
+     * Parse a comma separated list of "pdcp", "rlc", "sinr", "rssi" and
+     * "position".
+     * \param list The list; empty disables the monitor
+     * \param mask Set to the measurements of the list
+     * \return false on an unknown name
+     */
+    static bool ParseMeasurements(const std::string& list, uint32_t& mask);
+
+    /**
+     * Arm the monitor for the replication about to run.
+     * \param required Measurements to wait for; 0 disables the monitor
+     * \param quiescence Window without required events before stopping
+     */
+    void Start(uint32_t required, Time quiescence);
+
+    /// Record a measurement of the running replication
+    void Notify(Measurement measurement)
+    {
+        if (m_required & measurement)
+        {
+            Seen(measurement);
+        }
+    }
+
+    /// \return true if the replication stopped because it was complete
+    bool IsComplete() const;
+
+  private:
+    void Seen(Measurement measurement);
+    void Expire();
+
+    uint32_t m_required{0}; ///< measurements to wait for
+    uint32_t m_seen{0};     ///< required measurements seen so far
+    Time m_quiescence;
+    EventId m_stopEvent;    ///< pending end of the quiescence window
+    bool m_complete{false};
+};
+
+} // namespace ns3
+
+#endif // COMPLETION_MONITOR_H
@@ -0,0 +1,121 @@
+#include "interference-radius-loss-model.h"
+
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("InterferenceRadiusLossModel");
+
+NS_OBJECT_ENSURE_REGISTERED(InterferenceRadiusLossModel);
+
+TypeId
+InterferenceRadiusLossModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::InterferenceRadiusLossModel")
+            .SetParent<PropagationLossModel>()
+            .AddConstructor<InterferenceRadiusLossModel>()
+            .AddAttribute("Radius",
+                          "Horizontal distance in meters beyond which a link is neither "
+                          "computed nor delivered; 0 for no limit",
+                          DoubleValue(1000.0),
+                          MakeDoubleAccessor(&InterferenceRadiusLossModel::m_radius),
+                          MakeDoubleChecker<double>(0.0));
+    return tid;
+}
+
+InterferenceRadiusLossModel::InterferenceRadiusLossModel()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+InterferenceRadiusLossModel::~InterferenceRadiusLossModel()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+InterferenceRadiusLossModel::SetWrappedModel(Ptr<PropagationLossModel> model)
+{
+    m_wrapped = model;
+}
+
+void
+InterferenceRadiusLossModel::SetPartitions(std::vector<int32_t> partitionOfNode)
+{
+    m_partitionOfNode = std::move(partitionOfNode);
+}
+
+Ptr<InterferenceRadiusLossModel>
+InterferenceRadiusLossModel::Install(Ptr<SpectrumChannel> channel, double radius)
+{
+    Ptr<InterferenceRadiusLossModel> pruning = CreateObject<InterferenceRadiusLossModel>();
+    pruning->SetAttribute("Radius", DoubleValue(radius));
+    pruning->SetWrappedModel(channel->GetPropagationLossModel());
+    // As in CachedPropagationLossModel::Install, the wrapped model is
+    // called directly, so cut the chain
+    channel->AddPropagationLossModel(pruning);
+    pruning->SetNext(nullptr);
+    channel->SetAttribute("MaxLossDb", DoubleValue(PRUNED_LOSS_DB / 2));
+    return pruning;
+}
+
+bool
+InterferenceRadiusLossModel::IsCut(Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+{
+    Vector pa = a->GetPosition();
+    Vector pb = b->GetPosition();
+    double dx = pa.x - pb.x;
+    double dy = pa.y - pb.y;
+    if (m_radius > 0.0 && dx * dx + dy * dy > m_radius * m_radius)
+    {
+        return true;
+    }
+    if (!m_partitionOfNode.empty())
+    {
+        // A node in no partition (-1) links with every partition
+        int32_t partitionA = PartitionOf(a);
+        int32_t partitionB = PartitionOf(b);
+        if (partitionA >= 0 && partitionB >= 0 && partitionA != partitionB)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+double
+InterferenceRadiusLossModel::DoCalcRxPower(double txPowerDbm,
+                                           Ptr<MobilityModel> a,
+                                           Ptr<MobilityModel> b) const
+{
+    NS_ASSERT_MSG(m_wrapped, "No model to prune");
+    if (IsCut(a, b))
+    {
+        return txPowerDbm - PRUNED_LOSS_DB;
+    }
+    return m_wrapped->CalcRxPower(txPowerDbm, a, b);
+}
+
+int32_t
+InterferenceRadiusLossModel::PartitionOf(Ptr<MobilityModel> mobility) const
+{
+    Ptr<Node> node = mobility->GetObject<Node>();
+    if (!node || node->GetId() >= m_partitionOfNode.size())
+    {
+        return -1;
+    }
+    return m_partitionOfNode[node->GetId()];
+}
+
+int64_t
+InterferenceRadiusLossModel::DoAssignStreams(int64_t stream)
+{
+    return m_wrapped ? m_wrapped->AssignStreams(stream) : 0;
+}
+
+} // namespace ns3
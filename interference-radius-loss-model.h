@@ -0,0 +1,77 @@
+#ifndef INTERFERENCE_RADIUS_LOSS_MODEL_H
+#define INTERFERENCE_RADIUS_LOSS_MODEL_H
+
+#include "ns3/propagation-loss-model.h"
+#include "ns3/spectrum-channel.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Decorator that cuts off the links longer than an interference
+ * radius, or between partitions of the scenario.
+ *
+ * Links within Radius (horizontal distance) get the loss of the wrapped
+ * model. Longer ones, and those between nodes of different partitions, get
+ * PRUNED_LOSS_DB without calling it, and Install
+ * sets the MaxLossDb of the channel below that, so the channel drops them
+ * before the fast fading, beamforming and interference computations. With
+ * hundreds of cells, this keeps the expensive per-transmission work
+ * proportional to the cells around the transmitter instead of to all of
+ * them. The channel still hands every receiver to the loss chain, so each
+ * transmission keeps an all-pairs pass of distance tests; pruning that too
+ * would take a spectrum channel that looks its receivers up in a spatial
+ * index, which a loss model cannot do.
+ */
+class InterferenceRadiusLossModel : public PropagationLossModel
+{
+  public:
+    /// Loss reported for a link beyond the radius [dB]
+    static constexpr double PRUNED_LOSS_DB = 1000.0;
+
+    static TypeId GetTypeId();
+
+    InterferenceRadiusLossModel();
+    ~InterferenceRadiusLossModel() override;
+
+    /// \param model The model computing the losses within the radius
+    void SetWrappedModel(Ptr<PropagationLossModel> model);
+
+    /**
+     * \param partitionOfNode Partition of each node, by node id; nodes
+     * outside it or at -1 are in no partition and never cut off
+     */
+    void SetPartitions(std::vector<int32_t> partitionOfNode);
+
+    /**
+     * Put a cut-off in front of the loss chain of \p channel, e.g. after
+     * CachedPropagationLossModel::Install.
+     * \param channel The spectrum channel
+     * \param radius See the Radius attribute [m]
+     * \return the installed model
+     */
+    static Ptr<InterferenceRadiusLossModel> Install(Ptr<SpectrumChannel> channel, double radius);
+
+    /// \return whether the link between \p a and \p b is cut off
+    bool IsCut(Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
+
+  private:
+    double DoCalcRxPower(double txPowerDbm,
+                         Ptr<MobilityModel> a,
+                         Ptr<MobilityModel> b) const override;
+    int64_t DoAssignStreams(int64_t stream) override;
+
+    /// \return the partition of the node of \p mobility, -1 for none
+    int32_t PartitionOf(Ptr<MobilityModel> mobility) const;
+
+    Ptr<PropagationLossModel> m_wrapped;
+    double m_radius;
+    std::vector<int32_t> m_partitionOfNode;
+};
+
+} // namespace ns3
+
+#endif // INTERFERENCE_RADIUS_LOSS_MODEL_H
@@ -0,0 +1,109 @@
+#include "link-budget.h"
+
+#include "ns3/abort.h"
+#include "ns3/boolean.h"
+#include "ns3/channel-condition-model.h"
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/three-gpp-propagation-loss-model.h"
+
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("LinkBudget");
+
+namespace
+{
+
+/// Thermal noise density at 290 K [dBm/Hz]
+const double THERMAL_NOISE_DBM_HZ = 10.0 * std::log10(1.380649e-23 * 290.0 * 1000.0);
+
+/// Subcarriers per resource block
+const uint32_t SUBCARRIERS_PER_RB = 12;
+
+/// Default value of a double attribute of \p type
+double
+DefaultDouble(const std::string& type, const std::string& attribute)
+{
+    TypeId::AttributeInformation info;
+    NS_ABORT_MSG_UNLESS(TypeId::LookupByName(type).LookupAttributeByName(attribute, &info),
+                        "No attribute " << type << "::" << attribute);
+    Ptr<const DoubleValue> value = DynamicCast<const DoubleValue>(info.initialValue);
+    NS_ABORT_MSG_UNLESS(value, type << "::" << attribute << " is not a double");
+    return value->Get();
+}
+
+} // namespace
+
+LinkBudget::LinkBudget(double frequency,
+                       double bandwidth,
+                       uint16_t numerology,
+                       uint32_t gnbElements,
+                       uint32_t ueElements)
+{
+    // The model of BandwidthPartInfo::UMi_StreetCanyon_LoS, configured as
+    // in BuildScenario
+    Ptr<ThreeGppPropagationLossModel> model =
+        CreateObject<ThreeGppUmiStreetCanyonPropagationLossModel>();
+    model->SetAttribute("Frequency", DoubleValue(frequency));
+    model->SetAttribute("ShadowingEnabled", BooleanValue(false));
+    model->SetChannelConditionModel(CreateObject<AlwaysLosChannelConditionModel>());
+    m_model = model;
+    m_pathloss = model;
+
+    m_txPowerDbm = DefaultDouble("ns3::NrGnbPhy", "TxPower");
+    m_arrayGainDb = 10.0 * std::log10(static_cast<double>(gnbElements) * ueElements);
+
+    // The PHY spreads the power over whole resource blocks of the BWP
+    const double subcarrierSpacing = 15e3 * (1 << numerology);
+    const double rbs = std::floor(bandwidth / (SUBCARRIERS_PER_RB * subcarrierSpacing));
+    NS_ABORT_MSG_IF(rbs < 1, "The bandwidth holds no resource block");
+    m_noiseDbm = THERMAL_NOISE_DBM_HZ +
+                 10.0 * std::log10(rbs * SUBCARRIERS_PER_RB * subcarrierSpacing) +
+                 DefaultDouble("ns3::NrUePhy", "NoiseFigure");
+    NS_LOG_INFO("TxPower " << m_txPowerDbm << " dBm, array gain " << m_arrayGainDb
+                           << " dB, noise " << m_noiseDbm << " dBm");
+}
+
+void
+LinkBudget::SetPathlossCache(std::shared_ptr<PathlossCache> cache, double maxErrorDb)
+{
+    Ptr<CachedPropagationLossModel> cached = CreateObject<CachedPropagationLossModel>();
+    cached->SetAttribute("MaxErrorDb", DoubleValue(maxErrorDb));
+    cached->SetWrappedModel(m_model);
+    cached->SetCache(cache);
+    m_pathloss = cached;
+}
+
+LinkBudget::Link
+LinkBudget::Compute(Ptr<MobilityModel> ue, const NodeContainer& gnbs) const
+{
+    NS_ABORT_MSG_IF(gnbs.GetN() == 0, "No gNB to attach to");
+    Link link;
+    double closest = std::numeric_limits<double>::infinity();
+    Ptr<MobilityModel> serving;
+    for (uint32_t i = 0; i < gnbs.GetN(); ++i)
+    {
+        Ptr<MobilityModel> gnb = gnbs.Get(i)->GetObject<MobilityModel>();
+        double distance = gnb->GetDistanceFrom(ue);
+        if (distance < closest)
+        {
+            closest = distance;
+            serving = gnb;
+            link.gnb = i;
+        }
+    }
+
+    link.rxPowerDbm = m_pathloss->CalcRxPower(m_txPowerDbm + m_arrayGainDb, serving, ue);
+    double signalMw = std::pow(10.0, link.rxPowerDbm / 10.0);
+    double noiseMw = std::pow(10.0, m_noiseDbm / 10.0);
+    link.sinr = signalMw / noiseMw;
+    link.rssiDbm = 10.0 * std::log10(signalMw + noiseMw);
+    return link;
+}
+
+} // namespace ns3
@@ -0,0 +1,89 @@
+#ifndef LINK_BUDGET_H
+#define LINK_BUDGET_H
+
+#include "cached-propagation-loss-model.h"
+
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/propagation-loss-model.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace ns3
+{
+
+/**
+ * \brief Analytic downlink link budget of the 5Gmain.cc scenario.
+ *
+ * Computes what the full NR stack reports for a UE, without building or
+ * running it:
+ *  - received power: gNB TxPower + array gain - pathloss, with the pathloss
+ *    of the same 3GPP UMi street canyon model (LoS, no shadowing) that the
+ *    BWP uses,
+ *  - noise: kTB over the resource blocks of the BWP, plus the UE NoiseFigure,
+ *  - SINR = signal / noise, as only the serving gNB transmits data,
+ *  - RSSI = signal + noise, as the RssiPerProcessedChunk trace sums them.
+ *
+ * The array gain is that of ideal direct-path beamforming with isotropic
+ * elements, i.e. the number of gNB elements times the number of UE
+ * elements. What the model leaves out is the small-scale fading of the
+ * 3GPP channel, which spreads part of the power over clusters outside the
+ * beam, and HARQ; Main5G-loop.cpp --validateFastPath measures the error
+ * this makes against full-stack runs.
+ *
+ * TxPower and NoiseFigure are the defaults of NrGnbPhy and NrUePhy, so
+ * Config::SetDefault on them applies here as well.
+ */
+class LinkBudget
+{
+  public:
+    /**
+     * \param frequency Central frequency of the band [Hz]
+     * \param bandwidth Bandwidth of the BWP [Hz]
+     * \param numerology Numerology of the BWP
+     * \param gnbElements Number of antenna elements of a gNB
+     * \param ueElements Number of antenna elements of a UE
+     */
+    LinkBudget(double frequency,
+               double bandwidth,
+               uint16_t numerology,
+               uint32_t gnbElements,
+               uint32_t ueElements);
+
+    /**
+     * Serve the pathloss from a cache, as the full stack does with
+     * --pathlossCacheBin.
+     * \param cache The table to use
+     * \param maxErrorDb See CachedPropagationLossModel::MaxErrorDb
+     */
+    void SetPathlossCache(std::shared_ptr<PathlossCache> cache, double maxErrorDb);
+
+    /// Link of a UE to its serving gNB
+    struct Link
+    {
+        uint32_t gnb{0};     ///< index of the serving (closest) gNB
+        double rxPowerDbm{0.0};
+        double rssiDbm{0.0};
+        double sinr{0.0};    ///< linear
+    };
+
+    /**
+     * \param ue Mobility model of the UE
+     * \param gnbs The gNBs; the UE is served by the closest, as with
+     * NrHelper::AttachToClosestEnb
+     * \return the downlink of the UE
+     */
+    Link Compute(Ptr<MobilityModel> ue, const NodeContainer& gnbs) const;
+
+  private:
+    Ptr<PropagationLossModel> m_model;    ///< the 3GPP pathloss model
+    Ptr<PropagationLossModel> m_pathloss; ///< m_model, or a cache of it
+    double m_txPowerDbm;  ///< gNB transmit power [dBm]
+    double m_arrayGainDb; ///< beamforming gain of both arrays [dB]
+    double m_noiseDbm;    ///< noise power over the BWP [dBm]
+};
+
+} // namespace ns3
+
+#endif // LINK_BUDGET_H
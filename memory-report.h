@@ -0,0 +1,142 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define MEMORY_REPORT_HAVE_MALLINFO2 1
+#endif
+
+/**
+ * \brief Memory footprint of the phases of a scenario build.
+ *
+ * The heap in use is sampled at the end of each phase and the growth over
+ * the previous sample is charged to that phase, i.e. to the subsystem it
+ * builds, then divided over the units it builds (gNBs, UEs, links), to
+ * give bytes per unit. Everything allocated during a phase counts, so
+ * e.g. the UE device phase includes the UE side of the channel set up by
+ * the helper.
+ *
+ * The heap is read from mallinfo2() where glibc has it, which counts live
+ * allocations exactly; otherwise from the resident set, which is coarser
+ * (pages) and does not shrink on free.
+ */
+class MemoryReport
+{
+  public:
+    /// \return the heap bytes in use by this process
+    static uint64_t HeapBytes()
+    {
+#ifdef MEMORY_REPORT_HAVE_MALLINFO2
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+#else
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        FILE* statm = std::fopen("/proc/self/statm", "r");
+        if (statm)
+        {
+            if (std::fscanf(statm, "%lu %lu", &size, &resident) != 2)
+            {
+                resident = 0;
+            }
+            std::fclose(statm);
+        }
+        return static_cast<uint64_t>(resident) * sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    /// \return the peak resident set of this process [bytes]
+    static uint64_t PeakResidentBytes()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+    }
+
+    /// Start a report; the next phase is charged from here
+    void Begin()
+    {
+        m_phases.clear();
+        m_last = HeapBytes();
+        m_active = true;
+    }
+
+    /**
+     * End a phase.
+     * \param subsystem What the phase built
+     * \param units How many of \p unit it built; 0 reports the total only
+     * \param unit e.g. "gNB", "UE", "link"
+     */
+    void Mark(const std::string& subsystem, uint64_t units, const std::string& unit)
+    {
+        if (!m_active)
+        {
+            return;
+        }
+        uint64_t now = HeapBytes();
+        m_phases.push_back({subsystem, static_cast<int64_t>(now - m_last), units, unit});
+        m_last = now;
+    }
+
+    /// Stop charging phases, e.g. after the first replication
+    void End()
+    {
+        m_active = false;
+    }
+
+    bool IsActive() const
+    {
+        return m_active;
+    }
+
+    void Print(std::ostream& os) const
+    {
+        int64_t total = 0;
+        os << "Memory report (heap growth per phase)" << std::endl;
+        os << "  " << std::left << std::setw(32) << "subsystem" << std::right << std::setw(14)
+           << "total [KiB]" << std::setw(16) << "bytes per unit" << std::endl;
+        for (const Phase& phase : m_phases)
+        {
+            os << "  " << std::left << std::setw(32) << phase.subsystem << std::right
+               << std::setw(14) << std::fixed << std::setprecision(1) << phase.bytes / 1024.0;
+            if (phase.units > 0)
+            {
+                os << std::setw(16) << std::setprecision(0)
+                   << static_cast<double>(phase.bytes) / phase.units << " per " << phase.unit;
+            }
+            os << std::endl;
+            total += phase.bytes;
+        }
+        os << "  " << std::left << std::setw(32) << "total" << std::right << std::setw(14)
+           << std::setprecision(1) << total / 1024.0 << std::endl;
+        os << "  peak resident set " << std::setprecision(1) << PeakResidentBytes() / 1048576.0
+           << " MiB" << std::endl;
+        os.unsetf(std::ios::floatfield);
+        os << std::setprecision(6);
+    }
+
+  private:
+    struct Phase
+    {
+        std::string subsystem;
+        int64_t bytes; ///< may be negative if the phase freed memory
+        uint64_t units;
+        std::string unit;
+    };
+
+    std::vector<Phase> m_phases;
+    uint64_t m_last{0};
+    bool m_active{false};
+};
+
+#endif // MEMORY_REPORT_H
@@ -0,0 +1,193 @@
+#ifndef PHILOX_RNG_H
+#define PHILOX_RNG_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PHILOX_HAVE_AVX2_KERNEL 1
+#endif
+
+/**
+ * \file
+ * Counter-based random numbers: Philox4x32-10 of J. K. Salmon et al.,
+ * "Parallel random numbers: as easy as 1, 2, 3", SC 2011.
+ *
+ * A draw is a pure function of (seed, run, stream, index, draw number), so
+ * it does not depend on which process or thread computes it, on how the
+ * replications are split, or on what was drawn before. There is no
+ * generator state to create, seed or carry across a fork().
+ */
+
+/// Streams of PhiloxRng used by the simulator and the loop driver
+enum PhiloxStream : uint32_t
+{
+    PHILOX_STREAM_UE_POSITION = 1,   ///< initial UE position, draws 0 (x) and 1 (y)
+    PHILOX_STREAM_USER_PRIORITY = 2, ///< user priority of a replication, draw 0
+    PHILOX_STREAM_TRAFFIC = 3,       ///< Poisson bursts of a flow, draw k: gap before burst k
+};
+
+/// Philox4x32 multipliers and Weyl key increments
+constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+constexpr uint32_t PHILOX_W0 = 0x9E3779B9;
+constexpr uint32_t PHILOX_W1 = 0xBB67AE85;
+
+/**
+ * Philox4x32-10 block function.
+ * \param ctr The counter; replaced by the four random words
+ * \param key The key
+ */
+inline void
+Philox4x32(uint32_t ctr[4], const uint32_t key[2])
+{
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    for (int round = 0; round < 10; ++round)
+    {
+        uint64_t p0 = static_cast<uint64_t>(PHILOX_M0) * ctr[0];
+        uint64_t p1 = static_cast<uint64_t>(PHILOX_M1) * ctr[2];
+        uint32_t c0 = static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ k0;
+        uint32_t c2 = static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ k1;
+        ctr[0] = c0;
+        ctr[1] = static_cast<uint32_t>(p1);
+        ctr[2] = c2;
+        ctr[3] = static_cast<uint32_t>(p0);
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+/// Uniform double in [0, 1) from the top 52 bits of two words
+inline double
+PhiloxToUniform(uint32_t low, uint32_t high)
+{
+    uint64_t bits = ((static_cast<uint64_t>(high) << 32 | low) >> 12) | 0x3FF0000000000000ULL;
+    double one;
+    __builtin_memcpy(&one, &bits, sizeof(one));
+    return one - 1.0;
+}
+
+/**
+ * \brief Uniform random numbers keyed by (seed, run, stream, index).
+ *
+ * The key of Philox is (seed, stream) and the counter is (index, draw / 2,
+ * run), so every (run, index) pair, e.g. a UE of a replication, has its own
+ * sequence of draws in each stream; one block gives two draws.
+ */
+class PhiloxRng
+{
+  public:
+    /**
+     * \param seed The seed, e.g. RngSeedManager::GetSeed
+     * \param run The run, e.g. RngSeedManager::GetRun
+     * \param stream The stream, see PhiloxStream
+     */
+    PhiloxRng(uint32_t seed, uint64_t run, uint32_t stream)
+        : m_key{seed, stream},
+          m_runLow(static_cast<uint32_t>(run)),
+          m_runHigh(static_cast<uint32_t>(run >> 32))
+    {
+    }
+
+    /**
+     * \param index Index of the entity, e.g. the UE
+     * \param draw Number of the draw for that entity
+     * \return a uniform double in [0, 1)
+     */
+    double Uniform(uint32_t index, uint32_t draw) const
+    {
+        uint32_t ctr[4] = {index, draw >> 1, m_runLow, m_runHigh};
+        Philox4x32(ctr, m_key);
+        return (draw & 1) ? PhiloxToUniform(ctr[2], ctr[3]) : PhiloxToUniform(ctr[0], ctr[1]);
+    }
+
+    /**
+     * Draw \p draw of the entities firstIndex .. firstIndex + n - 1, i.e.
+     * out[i] = Uniform(firstIndex + i, draw), with the AVX2 kernel when the
+     * CPU supports it.
+     */
+    void UniformBatch(uint32_t firstIndex, std::size_t n, uint32_t draw, double* out) const
+    {
+        std::size_t i = 0;
+#ifdef PHILOX_HAVE_AVX2_KERNEL
+        static const bool haveAvx2 = __builtin_cpu_supports("avx2");
+        if (haveAvx2)
+        {
+            i = UniformBatchAvx2(firstIndex, n, draw, out);
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            out[i] = Uniform(firstIndex + static_cast<uint32_t>(i), draw);
+        }
+    }
+
+  private:
+#ifdef PHILOX_HAVE_AVX2_KERNEL
+    /// 32x32 -> 64 bit products of the eight lanes of a with m
+    __attribute__((target("avx2"))) static void MulHiLo(__m256i a, __m256i m, __m256i& hi, __m256i& lo)
+    {
+        __m256i even = _mm256_mul_epu32(a, m);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+        lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
+
+    /**
+     * Eight entities per iteration, one per 32-bit lane of each counter
+     * word.
+     * \return the number of entities done; the tail is left to the caller
+     */
+    __attribute__((target("avx2"))) std::size_t
+    UniformBatchAvx2(uint32_t firstIndex, std::size_t n, uint32_t draw, double* out) const
+    {
+        const __m256i m0 = _mm256_set1_epi32(static_cast<int>(PHILOX_M0));
+        const __m256i m1 = _mm256_set1_epi32(static_cast<int>(PHILOX_M1));
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i exponent = _mm256_set1_epi64x(0x3FF0000000000000LL);
+        const __m256d one = _mm256_set1_pd(1.0);
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(firstIndex + i)), lanes);
+            __m256i c1 = _mm256_set1_epi32(static_cast<int>(draw >> 1));
+            __m256i c2 = _mm256_set1_epi32(static_cast<int>(m_runLow));
+            __m256i c3 = _mm256_set1_epi32(static_cast<int>(m_runHigh));
+            uint32_t k0 = m_key[0];
+            uint32_t k1 = m_key[1];
+            for (int round = 0; round < 10; ++round)
+            {
+                __m256i hi0, lo0, hi1, lo1;
+                MulHiLo(c0, m0, hi0, lo0);
+                MulHiLo(c2, m1, hi1, lo1);
+                c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+                c1 = lo1;
+                c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+                c3 = lo0;
+                k0 += PHILOX_W0;
+                k1 += PHILOX_W1;
+            }
+            __m256i low = (draw & 1) ? c2 : c0;
+            __m256i high = (draw & 1) ? c3 : c1;
+            // 64-bit words of entities (0, 1 | 4, 5) and (2, 3 | 6, 7)
+            __m256i a = _mm256_unpacklo_epi32(low, high);
+            __m256i b = _mm256_unpackhi_epi32(low, high);
+            __m256i first = _mm256_permute2x128_si256(a, b, 0x20);
+            __m256i second = _mm256_permute2x128_si256(a, b, 0x31);
+            first = _mm256_or_si256(_mm256_srli_epi64(first, 12), exponent);
+            second = _mm256_or_si256(_mm256_srli_epi64(second, 12), exponent);
+            _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_castsi256_pd(first), one));
+            _mm256_storeu_pd(out + i + 4, _mm256_sub_pd(_mm256_castsi256_pd(second), one));
+        }
+        return i;
+    }
+#endif // PHILOX_HAVE_AVX2_KERNEL
+
+    uint32_t m_key[2];
+    uint32_t m_runLow;
+    uint32_t m_runHigh;
+};
+
+#endif // PHILOX_RNG_H
@@ -0,0 +1,180 @@
+#include "position-sampler.h"
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("PositionSampler");
+
+namespace
+{
+
+const char POSITION_FILE_MAGIC[8] = {'5', 'G', 'P', 'O', 'S', 'S', 'O', 'A'};
+const uint32_t POSITION_FILE_VERSION = 1;
+
+/// Samples (ticks x nodes) per block, i.e. 512 KiB per coordinate
+const std::size_t SAMPLES_PER_BLOCK = 65536;
+
+/// Write all of \p iov with as few writev() calls as possible
+bool
+WriteAllV(int fd, struct iovec* iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t n = ::writev(fd, iov, count);
+        if (n <= 0)
+        {
+            return false;
+        }
+        // Skip what was written, normally everything at once
+        while (count > 0 && static_cast<std::size_t>(n) >= iov->iov_len)
+        {
+            n -= static_cast<ssize_t>(iov->iov_len);
+            ++iov;
+            --count;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= static_cast<std::size_t>(n);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+PositionSampler::~PositionSampler()
+{
+    Close();
+}
+
+bool
+PositionSampler::Open(const std::string& path)
+{
+    Close();
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    m_headerWritten = false;
+    return m_fd >= 0;
+}
+
+bool
+PositionSampler::IsOpen() const
+{
+    return m_fd >= 0;
+}
+
+void
+PositionSampler::SetNodes(NodeContainer nodes)
+{
+    std::vector<uint32_t> nodeIds;
+    m_models.clear();
+    for (uint32_t i = 0; i < nodes.GetN(); ++i)
+    {
+        Ptr<MobilityModel> model = nodes.Get(i)->GetObject<MobilityModel>();
+        NS_ABORT_MSG_UNLESS(model, "Node " << nodes.Get(i)->GetId() << " has no mobility model");
+        m_models.push_back(model);
+        nodeIds.push_back(nodes.Get(i)->GetId());
+    }
+    NS_ABORT_MSG_IF(m_headerWritten && nodeIds != m_nodeIds,
+                    "All replications in a position file must sample the same nodes");
+    m_nodeIds = nodeIds;
+
+    std::size_t nodeCount = std::max<std::size_t>(1, m_models.size());
+    m_ticksPerBlock = std::max<std::size_t>(1, SAMPLES_PER_BLOCK / nodeCount);
+    m_time.resize(m_ticksPerBlock);
+    m_x.resize(m_ticksPerBlock * m_models.size());
+    m_y.resize(m_ticksPerBlock * m_models.size());
+    m_z.resize(m_ticksPerBlock * m_models.size());
+    m_ticks = 0;
+
+    if (m_fd >= 0 && !m_headerWritten)
+    {
+        uint32_t nodeCount32 = static_cast<uint32_t>(m_nodeIds.size());
+        struct iovec iov[4] = {
+            {const_cast<char*>(POSITION_FILE_MAGIC), sizeof(POSITION_FILE_MAGIC)},
+            {const_cast<uint32_t*>(&POSITION_FILE_VERSION), sizeof(uint32_t)},
+            {&nodeCount32, sizeof(uint32_t)},
+            {m_nodeIds.data(), m_nodeIds.size() * sizeof(uint32_t)},
+        };
+        m_headerWritten = WriteAllV(m_fd, iov, 4);
+    }
+}
+
+void
+PositionSampler::Start(Time interval)
+{
+    NS_ABORT_MSG_UNLESS(interval.IsStrictlyPositive(), "The sampling interval must be positive");
+    m_interval = interval;
+    m_ticks = 0;
+    Simulator::ScheduleNow(&PositionSampler::Sample, this);
+}
+
+void
+PositionSampler::Sample()
+{
+    const std::size_t nodeCount = m_models.size();
+    const std::size_t base = m_ticks * nodeCount;
+    m_time[m_ticks] = Simulator::Now().GetNanoSeconds();
+    for (std::size_t i = 0; i < nodeCount; ++i)
+    {
+        Vector pos = m_models[i]->GetPosition();
+        m_x[base + i] = pos.x;
+        m_y[base + i] = pos.y;
+        m_z[base + i] = pos.z;
+    }
+    if (++m_ticks == m_ticksPerBlock)
+    {
+        Flush();
+    }
+    Simulator::Schedule(m_interval, &PositionSampler::Sample, this);
+}
+
+void
+PositionSampler::Flush()
+{
+    if (m_fd < 0 || m_ticks == 0)
+    {
+        m_ticks = 0;
+        return;
+    }
+    const std::size_t samples = m_ticks * m_models.size();
+    uint32_t blockHeader[2] = {static_cast<uint32_t>(RngSeedManager::GetRun()),
+                               static_cast<uint32_t>(m_ticks)};
+    struct iovec iov[5] = {
+        {blockHeader, sizeof(blockHeader)},
+        {m_time.data(), m_ticks * sizeof(int64_t)},
+        {m_x.data(), samples * sizeof(double)},
+        {m_y.data(), samples * sizeof(double)},
+        {m_z.data(), samples * sizeof(double)},
+    };
+    if (!WriteAllV(m_fd, iov, 5))
+    {
+        NS_LOG_WARN("Failed to write " << m_ticks << " position samples");
+    }
+    m_ticks = 0;
+}
+
+void
+PositionSampler::Close()
+{
+    if (m_fd >= 0)
+    {
+        Flush();
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+} // namespace ns3
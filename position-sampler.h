@@ -0,0 +1,85 @@
+#ifndef POSITION_SAMPLER_H
+#define POSITION_SAMPLER_H
+
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Periodic sampler of node positions into structure-of-arrays
+ * blocks.
+ *
+ * The MobilityModel of every node is looked up once, in SetNodes. Each
+ * tick then only reads the positions into preallocated x, y and z arrays.
+ * When a block is full, or at the end of a replication, it is written out
+ * with a single writev().
+ *
+ * File layout, native byte order: a header
+ * {char magic[8] = "5GPOSSOA", uint32_t version, uint32_t nodeCount},
+ * then nodeCount uint32_t node ids, then blocks of
+ * {uint32_t run, uint32_t ticks, int64_t timeNs[ticks], double x[ticks][nodeCount],
+ *  double y[ticks][nodeCount], double z[ticks][nodeCount]}.
+ * Since a block goes out in a single O_APPEND write, several processes,
+ * e.g. forked replications, can share one file.
+ */
+class PositionSampler
+{
+  public:
+    PositionSampler() = default;
+    ~PositionSampler();
+
+    PositionSampler(const PositionSampler&) = delete;
+    PositionSampler& operator=(const PositionSampler&) = delete;
+
+    /**
+     * Create (or truncate) \p path. The header is written by the first
+     * SetNodes call.
+     * @return false if the file cannot be created.
+     */
+    bool Open(const std::string& path);
+
+    bool IsOpen() const;
+
+    /**
+     * Cache the mobility models of \p nodes and size the buffers for them.
+     * All replications written to one file must sample the same nodes.
+     */
+    void SetNodes(NodeContainer nodes);
+
+    /**
+     * Sample every \p interval from now on, until the simulator stops.
+     * Call Flush from Simulator::ScheduleDestroy to write the last block.
+     */
+    void Start(Time interval);
+
+    /// Write the buffered ticks of the current run, if any
+    void Flush();
+
+    void Close();
+
+  private:
+    void Sample();
+
+    int m_fd{-1};
+    bool m_headerWritten{false};
+    Time m_interval;
+    std::vector<Ptr<MobilityModel>> m_models;
+    std::vector<uint32_t> m_nodeIds;
+    std::size_t m_ticksPerBlock{0};
+    std::size_t m_ticks{0};      ///< ticks buffered in the current block
+    std::vector<int64_t> m_time; ///< [tick]
+    std::vector<double> m_x;     ///< [tick * nodes + node]
+    std::vector<double> m_y;     ///< [tick * nodes + node]
+    std::vector<double> m_z;     ///< [tick * nodes + node]
+};
+
+} // namespace ns3
+
+#endif // POSITION_SAMPLER_H
@@ -0,0 +1,302 @@
+#include "profiling-scheduler.h"
+
+#include "ns3/boolean.h"
+#include "ns3/log.h"
+#include "ns3/map-scheduler.h"
+#include "ns3/type-id.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <fstream>
+#include <map>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("ProfilingScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED(ProfilingScheduler);
+
+TelemetryCounters* ProfilingScheduler::s_telemetry = nullptr;
+
+namespace
+{
+
+/// Readable name of a type; the mangled name if demangling fails
+std::string
+Demangle(const std::type_info& type)
+{
+    int status = 0;
+    char* name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    std::string result = status == 0 && name != nullptr ? name : type.name();
+    std::free(name);
+    return result;
+}
+
+} // namespace
+
+EventProfile&
+EventProfile::Get()
+{
+    static EventProfile profile;
+    return profile;
+}
+
+void
+EventProfile::SetWindow(Time window)
+{
+    m_windowTs = window.GetTimeStep();
+}
+
+std::size_t
+EventProfile::TypeIndex(const std::type_info& type)
+{
+    if (&type == m_lastTypeInfo)
+    {
+        return m_lastTypeIndex;
+    }
+    auto it = m_typeIndex.find(&type);
+    if (it == m_typeIndex.end())
+    {
+        it = m_typeIndex.emplace(&type, m_types.size()).first;
+        m_types.push_back({Demangle(type), 0, 0.0});
+    }
+    m_lastTypeInfo = &type;
+    m_lastTypeIndex = it->second;
+    return it->second;
+}
+
+void
+EventProfile::Charge(double wall)
+{
+    TypeStats& stats = m_types[m_current];
+    ++stats.events;
+    stats.wall += wall;
+    Cell& cell = m_cells[(m_currentWindow << 20) | m_current];
+    ++cell.events;
+    cell.wall += wall;
+}
+
+void
+EventProfile::BeginEvent(const std::type_info& type, uint64_t ts)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (m_running)
+    {
+        Charge(std::chrono::duration<double>(now - m_start).count());
+    }
+    m_running = true;
+    m_current = TypeIndex(type);
+    m_currentWindow = m_windowTs > 0 ? ts / static_cast<uint64_t>(m_windowTs) : 0;
+    m_start = now;
+}
+
+void
+EventProfile::BeginRun()
+{
+    m_inRun = true;
+    m_running = false;
+}
+
+void
+EventProfile::EndRun()
+{
+    if (m_running)
+    {
+        Charge(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+        m_running = false;
+    }
+    m_inRun = false;
+}
+
+void
+EventProfile::Report(std::ostream& os) const
+{
+    double total = 0.0;
+    uint64_t events = 0;
+    std::vector<std::size_t> order(m_types.size());
+    for (std::size_t i = 0; i < m_types.size(); ++i)
+    {
+        order[i] = i;
+        total += m_types[i].wall;
+        events += m_types[i].events;
+    }
+    std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+        return m_types[a].wall > m_types[b].wall;
+    });
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "PROFILE total events=%llu wall=%.6f\n",
+                  static_cast<unsigned long long>(events), total);
+    os << line;
+    for (std::size_t i : order)
+    {
+        const TypeStats& stats = m_types[i];
+        std::snprintf(line,
+                      sizeof(line),
+                      "PROFILE share=%5.1f%% events=%llu wall=%.6f mean_us=%.3f type=",
+                      total > 0.0 ? 100.0 * stats.wall / total : 0.0,
+                      static_cast<unsigned long long>(stats.events),
+                      stats.wall,
+                      stats.events > 0 ? 1e6 * stats.wall / stats.events : 0.0);
+        os << line << stats.name << "\n";
+    }
+
+    // Per window totals, in simulated-time order
+    std::map<uint64_t, Cell> windows;
+    for (const auto& entry : m_cells)
+    {
+        Cell& window = windows[entry.first >> 20];
+        window.events += entry.second.events;
+        window.wall += entry.second.wall;
+    }
+    for (const auto& w : windows)
+    {
+        double start = Time::From(static_cast<int64_t>(w.first) * m_windowTs).GetSeconds();
+        std::snprintf(line,
+                      sizeof(line),
+                      "PROFILE_WINDOW start=%.6f events=%llu wall=%.6f\n",
+                      start,
+                      static_cast<unsigned long long>(w.second.events),
+                      w.second.wall);
+        os << line;
+    }
+}
+
+bool
+EventProfile::WriteStacks(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    for (const auto& entry : m_cells)
+    {
+        std::string name = m_types[entry.first & ((1 << 20) - 1)].name;
+        // ';' separates frames and ' ' the weight in the folded format
+        std::replace(name.begin(), name.end(), ';', ',');
+        std::replace(name.begin(), name.end(), ' ', '_');
+        double start =
+            Time::From(static_cast<int64_t>(entry.first >> 20) * m_windowTs).GetSeconds();
+        char window[32];
+        std::snprintf(window, sizeof(window), "t=%.3fs", start);
+        file << "sim;" << window << ";" << name << " "
+             << static_cast<uint64_t>(entry.second.wall * 1e6 + 0.5) << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+TypeId
+ProfilingScheduler::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::ProfilingScheduler")
+            .SetParent<Scheduler>()
+            .AddConstructor<ProfilingScheduler>()
+            .AddAttribute("WrappedScheduler",
+                          "The scheduler that actually holds the events.",
+                          TypeIdValue(MapScheduler::GetTypeId()),
+                          MakeTypeIdAccessor(&ProfilingScheduler::SetWrappedScheduler,
+                                             &ProfilingScheduler::GetWrappedScheduler),
+                          MakeTypeIdChecker())
+            .AddAttribute("Profile",
+                          "Whether to profile the events, rather than only count them "
+                          "for the telemetry segment.",
+                          BooleanValue(true),
+                          MakeBooleanAccessor(&ProfilingScheduler::m_profile),
+                          MakeBooleanChecker());
+    return tid;
+}
+
+ProfilingScheduler::ProfilingScheduler()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+ProfilingScheduler::~ProfilingScheduler()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+ProfilingScheduler::SetWrappedScheduler(TypeId type)
+{
+    ObjectFactory factory;
+    factory.SetTypeId(type);
+    m_wrapped = factory.Create<Scheduler>();
+}
+
+TypeId
+ProfilingScheduler::GetWrappedScheduler() const
+{
+    return m_wrapped ? m_wrapped->GetInstanceTypeId() : MapScheduler::GetTypeId();
+}
+
+void
+ProfilingScheduler::DoDispose()
+{
+    m_wrapped = nullptr;
+    Scheduler::DoDispose();
+}
+
+void
+ProfilingScheduler::Insert(const Event& ev)
+{
+    m_wrapped->Insert(ev);
+    ++m_pending;
+}
+
+bool
+ProfilingScheduler::IsEmpty() const
+{
+    return m_wrapped->IsEmpty();
+}
+
+Scheduler::Event
+ProfilingScheduler::PeekNext() const
+{
+    return m_wrapped->PeekNext();
+}
+
+Scheduler::Event
+ProfilingScheduler::RemoveNext()
+{
+    Event ev = m_wrapped->RemoveNext();
+    --m_pending;
+    // Events drained by Simulator::Destroy are neither profiled nor counted
+    EventProfile& profile = EventProfile::Get();
+    if (!profile.IsInRun())
+    {
+        return ev;
+    }
+    ++m_events;
+    if (m_profile)
+    {
+        profile.BeginEvent(typeid(*ev.impl), ev.key.m_ts);
+    }
+    if (s_telemetry)
+    {
+        s_telemetry->events.store(m_events, std::memory_order_relaxed);
+        s_telemetry->pendingEvents.store(m_pending, std::memory_order_relaxed);
+        s_telemetry->nowTicks.store(ev.key.m_ts, std::memory_order_relaxed);
+    }
+    return ev;
+}
+
+void
+ProfilingScheduler::Remove(const Event& ev)
+{
+    m_wrapped->Remove(ev);
+    --m_pending;
+}
+
+void
+ProfilingScheduler::SetTelemetry(TelemetryCounters* counters)
+{
+    s_telemetry = counters;
+}
+
+} // namespace ns3
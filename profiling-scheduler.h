@@ -0,0 +1,160 @@
+#ifndef PROFILING_SCHEDULER_H
+#define PROFILING_SCHEDULER_H
+
+#include "telemetry-shm.h"
+
+#include "ns3/nstime.h"
+#include "ns3/object-factory.h"
+#include "ns3/scheduler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Wall time and event counts per event type and per simulated-time
+ * window, filled in by ProfilingScheduler.
+ *
+ * The profile is process-wide, so it accumulates over all replications run
+ * by the process.
+ */
+class EventProfile
+{
+  public:
+    /// The profile of this process
+    static EventProfile& Get();
+
+    /// \param window Length of a simulated-time window
+    void SetWindow(Time window);
+
+    /**
+     * Account for the event the simulator is about to run, and charge the
+     * wall time since the previous call to the previous event.
+     * @param type Dynamic type of the event
+     * @param ts Timestamp of the event [time steps]
+     */
+    void BeginEvent(const std::type_info& type, uint64_t ts);
+
+    /// Start profiling; call right before Simulator::Run
+    void BeginRun();
+
+    /**
+     * Charge the time of the last event and stop profiling; call when
+     * Simulator::Run returns. The events Simulator::Destroy drains from the
+     * queue afterwards are never run, so they are not profiled.
+     */
+    void EndRun();
+
+    /// \return whether the events handed out are run, i.e. between BeginRun and EndRun
+    bool IsInRun() const
+    {
+        return m_inRun;
+    }
+
+    /**
+     * Print one line per event type, sorted by decreasing wall time,
+     * followed by one line per simulated-time window.
+     */
+    void Report(std::ostream& os) const;
+
+    /**
+     * Write the profile in the folded-stack format of flamegraph.pl, with
+     * stacks "sim;<window>;<event type>" weighted in microseconds.
+     * @return false if the file cannot be written.
+     */
+    bool WriteStacks(const std::string& path) const;
+
+  private:
+    /// Totals of one event type
+    struct TypeStats
+    {
+        std::string name;   ///< demangled type name
+        uint64_t events{0}; ///< number of events
+        double wall{0.0};   ///< wall time [s]
+    };
+
+    /// Totals of one (window, type) pair
+    struct Cell
+    {
+        uint64_t events{0};
+        double wall{0.0};
+    };
+
+    std::size_t TypeIndex(const std::type_info& type);
+    void Charge(double wall);
+
+    int64_t m_windowTs{0}; ///< window length [time steps], 0 until SetWindow
+    std::unordered_map<const std::type_info*, std::size_t> m_typeIndex;
+    std::vector<TypeStats> m_types;
+    std::unordered_map<uint64_t, Cell> m_cells; ///< keyed by window << 20 | type
+    const std::type_info* m_lastTypeInfo{nullptr}; ///< one-entry cache of m_typeIndex
+    std::size_t m_lastTypeIndex{0};
+    bool m_inRun{false};   ///< within Simulator::Run
+    bool m_running{false}; ///< an event is being timed
+    std::size_t m_current{0};
+    uint64_t m_currentWindow{0};
+    std::chrono::steady_clock::time_point m_start;
+};
+
+/**
+ * \brief Scheduler decorator that profiles the events it hands out.
+ *
+ * The simulator takes the next event with RemoveNext right before running
+ * it, so the wall time between two RemoveNext calls is the run time of the
+ * first event plus the scheduler's own overhead. That time is charged to
+ * the dynamic type of the event (the EventImpl created by MakeEvent), which
+ * names the callback's class and signature. Functions and members with the
+ * same signature on the same class share an entry. Only the events handed
+ * out between EventProfile::BeginRun and EndRun are profiled: the ones
+ * Simulator::Destroy drains afterwards are never run.
+ *
+ * The cost is a clock read and a hash lookup per event.
+ *
+ * It also keeps the event count, queue depth and simulated time of the
+ * segment set with SetTelemetry, if any, up to date, over the same events.
+ * With Profile set to false it does only that, at the cost of a few stores
+ * per event.
+ */
+class ProfilingScheduler : public Scheduler
+{
+  public:
+    static TypeId GetTypeId();
+
+    ProfilingScheduler();
+    ~ProfilingScheduler() override;
+
+    void Insert(const Event& ev) override;
+    bool IsEmpty() const override;
+    Event PeekNext() const override;
+    Event RemoveNext() override;
+    void Remove(const Event& ev) override;
+
+    /**
+     * Counters to update from every scheduler of the process, e.g. those
+     * of later replications; nullptr for none.
+     */
+    static void SetTelemetry(TelemetryCounters* counters);
+
+  private:
+    void SetWrappedScheduler(TypeId type);
+    TypeId GetWrappedScheduler() const;
+
+    void DoDispose() override;
+
+    Ptr<Scheduler> m_wrapped;
+    bool m_profile{true}; ///< feed EventProfile
+    uint64_t m_pending{0}; ///< events in the queue
+    uint64_t m_events{0};  ///< events handed out
+    static TelemetryCounters* s_telemetry;
+};
+
+} // namespace ns3
+
+#endif // PROFILING_SCHEDULER_H
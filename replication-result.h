@@ -0,0 +1,156 @@
+#ifndef REPLICATION_RESULT_H
+#define REPLICATION_RESULT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/**
+ * \brief Measurements collected during one replication of the 5G scenario.
+ *
+ * 5Gmain.cc fills one of these per replication from its trace callbacks and
+ * reports it as a single "RESULT" line, which Main5G-loop.cpp parses back
+ * with ParseResultLine instead of scraping the free-form trace output.
+ */
+struct ReplicationResult
+{
+    uint64_t run{0};       ///< RngRun used by the replication
+    bool delivered{false}; ///< the test packet was seen at both PDCP and RLC
+    double rssi{0.0};      ///< last RSSI reported by the UE [dBm]
+    double sinr{0.0};      ///< last DL data SINR (linear)
+    double se{0.0};        ///< spectral efficiency of the last SINR [bps/Hz]
+    double x{0.0};         ///< UE position, x [m]
+    double y{0.0};         ///< UE position, y [m]
+    double z{0.0};         ///< UE position, z [m]
+};
+
+/**
+ * Format a result as the single line exchanged between 5Gmain.cc and the
+ * loop driver.
+ * @param r The result to format.
+ * @param tag Marker at the start of the line; "PREDICTION" lines carry the
+ * analytic link budget of a full-stack run, see --fastPathCheck.
+ * @return The line, without trailing newline.
+ */
+inline std::string
+FormatResultLine(const ReplicationResult& r, const char* tag = "RESULT")
+{
+    char line[256];
+    std::snprintf(line,
+                  sizeof(line),
+                  "%s run=%llu ok=%d rssi=%.6f sinr=%.6f se=%.6f pos=%.6f,%.6f,%.6f",
+                  tag,
+                  static_cast<unsigned long long>(r.run),
+                  r.delivered ? 1 : 0,
+                  r.rssi,
+                  r.sinr,
+                  r.se,
+                  r.x,
+                  r.y,
+                  r.z);
+    return line;
+}
+
+/**
+ * Parse a line produced by FormatResultLine. The marker may appear anywhere
+ * in the line, so interleaved trace output does not hide it.
+ * @param line The line to parse.
+ * @param r The result to fill in.
+ * @param tag The marker to look for.
+ * @return true if the line contained a complete result.
+ */
+inline bool
+ParseResultLine(const char* line, ReplicationResult& r, const char* tag = "RESULT")
+{
+    const std::string marker = std::string(tag) + " run=";
+    const char* start = std::strstr(line, marker.c_str());
+    if (start == nullptr)
+    {
+        return false;
+    }
+    unsigned long long run = 0;
+    int ok = 0;
+    if (std::sscanf(start + marker.size(),
+                    "%llu ok=%d rssi=%lf sinr=%lf se=%lf pos=%lf,%lf,%lf",
+                    &run,
+                    &ok,
+                    &r.rssi,
+                    &r.sinr,
+                    &r.se,
+                    &r.x,
+                    &r.y,
+                    &r.z) != 8)
+    {
+        return false;
+    }
+    r.run = run;
+    r.delivered = ok != 0;
+    return true;
+}
+
+/**
+ * \brief Cost of one replication, reported by 5Gmain.cc as a "TIMING" line
+ * for the benchmark driver.
+ */
+struct ReplicationTiming
+{
+    uint64_t run{0};          ///< RngRun of the replication
+    double setupSeconds{0.0}; ///< wall time to build the scenario
+    double runSeconds{0.0};   ///< wall time of Simulator::Run
+    double simSeconds{0.0};   ///< simulated time covered by the run
+    uint64_t events{0};       ///< events executed by the simulator
+};
+
+/**
+ * Format a timing as a single line, see ParseTimingLine.
+ * @param t The timing to format.
+ * @return The line, without trailing newline.
+ */
+inline std::string
+FormatTimingLine(const ReplicationTiming& t)
+{
+    char line[256];
+    std::snprintf(line,
+                  sizeof(line),
+                  "TIMING run=%llu setup=%.6f wall=%.6f sim=%.6f events=%llu",
+                  static_cast<unsigned long long>(t.run),
+                  t.setupSeconds,
+                  t.runSeconds,
+                  t.simSeconds,
+                  static_cast<unsigned long long>(t.events));
+    return line;
+}
+
+/**
+ * Parse a line produced by FormatTimingLine.
+ * @param line The line to parse.
+ * @param t The timing to fill in.
+ * @return true if the line contained a complete timing.
+ */
+inline bool
+ParseTimingLine(const char* line, ReplicationTiming& t)
+{
+    const char* start = std::strstr(line, "TIMING run=");
+    if (start == nullptr)
+    {
+        return false;
+    }
+    unsigned long long run = 0;
+    unsigned long long events = 0;
+    if (std::sscanf(start,
+                    "TIMING run=%llu setup=%lf wall=%lf sim=%lf events=%llu",
+                    &run,
+                    &t.setupSeconds,
+                    &t.runSeconds,
+                    &t.simSeconds,
+                    &events) != 5)
+    {
+        return false;
+    }
+    t.run = run;
+    t.events = events;
+    return true;
+}
+
+#endif // REPLICATION_RESULT_H
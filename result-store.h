@@ -0,0 +1,142 @@
+#ifndef RESULT_STORE_H
+#define RESULT_STORE_H
+
+#include "replication-result.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * \brief Persistent, content-addressed store of replication results.
+ *
+ * Every result is keyed by a hash of everything that determines it: the
+ * scenario parameters as passed to 5Gmain.cc plus the RngRun. The store is
+ * an append-only text file with one "<key> RESULT ..." line per run, so
+ * several drivers can share it and a crash loses at most the line being
+ * written; partial or unparsable lines are skipped on load.
+ */
+class ResultStore
+{
+  public:
+    ResultStore() = default;
+
+    ~ResultStore()
+    {
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+        }
+    }
+
+    ResultStore(const ResultStore&) = delete;
+    ResultStore& operator=(const ResultStore&) = delete;
+
+    /**
+     * Load the results already in \p path and open it for appending,
+     * creating it if needed. Failed runs a store of an older version kept
+     * are skipped, so they are run again.
+     * @return false if the file cannot be opened for appending.
+     */
+    bool Open(const std::string& path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            unsigned long long key;
+            ReplicationResult result;
+            if (std::sscanf(line.c_str(), "%16llx ", &key) == 1 &&
+                ParseResultLine(line.c_str(), result) && result.delivered)
+            {
+                m_results[key] = result;
+            }
+        }
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        return m_fd >= 0;
+    }
+
+    /**
+     * Key of one run of one scenario.
+     * @param scenario Every parameter that influences the result, in a
+     * canonical form (e.g. the 5Gmain.cc command line of the run).
+     * @param run The RngRun.
+     */
+    static uint64_t MakeKey(const std::string& scenario, uint64_t run)
+    {
+        // 64-bit FNV-1a over the scenario string and the run number
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        auto mix = [&hash](unsigned char byte) {
+            hash ^= byte;
+            hash *= 0x100000001b3ULL;
+        };
+        for (char c : scenario)
+        {
+            mix(static_cast<unsigned char>(c));
+        }
+        mix(0);
+        for (int i = 0; i < 8; ++i)
+        {
+            mix(static_cast<unsigned char>(run >> (8 * i)));
+        }
+        return hash;
+    }
+
+    /**
+     * @param key The key of the run.
+     * @param result Set to the stored result if there is one.
+     * @return true if the run is in the store.
+     */
+    bool Find(uint64_t key, ReplicationResult& result) const
+    {
+        auto it = m_results.find(key);
+        if (it == m_results.end())
+        {
+            return false;
+        }
+        result = it->second;
+        return true;
+    }
+
+    /**
+     * Add a completed run. The line goes out with a single O_APPEND
+     * write(), which does not interleave with concurrent appenders. Runs
+     * that failed (the test packet was not delivered) are not kept, so a
+     * later sweep runs them again instead of reusing the failure.
+     */
+    void Add(uint64_t key, const ReplicationResult& result)
+    {
+        if (!result.delivered)
+        {
+            return;
+        }
+        m_results[key] = result;
+        if (m_fd < 0)
+        {
+            return;
+        }
+        char prefix[20];
+        std::snprintf(prefix, sizeof(prefix), "%016llx ", static_cast<unsigned long long>(key));
+        std::string line = prefix + FormatResultLine(result) + "\n";
+        if (::write(m_fd, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+        {
+            std::perror("result store");
+        }
+    }
+
+    std::size_t Size() const
+    {
+        return m_results.size();
+    }
+
+  private:
+    int m_fd{-1};
+    std::unordered_map<uint64_t, ReplicationResult> m_results;
+};
+
+#endif // RESULT_STORE_H
@@ -0,0 +1,205 @@
+#include "slot-calendar-scheduler.h"
+
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("SlotCalendarScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED(SlotCalendarScheduler);
+
+TypeId
+SlotCalendarScheduler::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::SlotCalendarScheduler")
+            .SetParent<Scheduler>()
+            .AddConstructor<SlotCalendarScheduler>()
+            .AddAttribute("BucketWidth",
+                          "Time covered by one bucket, ideally the OFDM symbol duration "
+                          "(slot / 14) of the numerology in use.",
+                          TimeValue(NanoSeconds(71429)),
+                          MakeTimeAccessor(&SlotCalendarScheduler::SetBucketWidth,
+                                           &SlotCalendarScheduler::GetBucketWidth),
+                          MakeTimeChecker(NanoSeconds(1)));
+    return tid;
+}
+
+SlotCalendarScheduler::SlotCalendarScheduler()
+{
+    NS_LOG_FUNCTION(this);
+    m_buckets.resize(MIN_BUCKETS);
+    m_mask = MIN_BUCKETS - 1;
+}
+
+SlotCalendarScheduler::~SlotCalendarScheduler()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+SlotCalendarScheduler::SetBucketWidth(Time width)
+{
+    NS_ASSERT_MSG(m_size == 0, "The bucket width can only be set on an empty queue");
+    m_width = std::max<int64_t>(1, width.GetTimeStep());
+    m_current = 0;
+    m_windowEnd = m_width;
+}
+
+Time
+SlotCalendarScheduler::GetBucketWidth() const
+{
+    return TimeStep(m_width);
+}
+
+std::size_t
+SlotCalendarScheduler::BucketOf(uint64_t ts) const
+{
+    return static_cast<std::size_t>(ts / m_width) & m_mask;
+}
+
+void
+SlotCalendarScheduler::Insert(const Event& ev)
+{
+    NS_LOG_FUNCTION(this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+    Bucket& bucket = m_buckets[BucketOf(ev.key.m_ts)];
+    if (bucket.Empty())
+    {
+        bucket.events.clear();
+        bucket.head = 0;
+    }
+    // Binary search within the bucket; equal keys keep insertion order
+    auto pos = std::upper_bound(bucket.events.begin() + bucket.head,
+                                bucket.events.end(),
+                                ev,
+                                [](const Event& a, const Event& b) { return a.key < b.key; });
+    bucket.events.insert(pos, ev);
+    // Behind the cursor, i.e. earlier than the event a peek moved it to
+    if (ev.key.m_ts < m_windowEnd - m_width)
+    {
+        m_current = BucketOf(ev.key.m_ts);
+        m_windowEnd = (ev.key.m_ts / m_width + 1) * m_width;
+    }
+    if (++m_size > 2 * m_buckets.size())
+    {
+        Resize(2 * m_buckets.size());
+    }
+}
+
+bool
+SlotCalendarScheduler::IsEmpty() const
+{
+    return m_size == 0;
+}
+
+std::size_t
+SlotCalendarScheduler::FindNext() const
+{
+    NS_ASSERT(m_size > 0);
+    // Walk one revolution of the calendar from the current window
+    for (std::size_t i = 0; i < m_buckets.size(); ++i)
+    {
+        const Bucket& bucket = m_buckets[m_current];
+        if (!bucket.Empty() && bucket.events[bucket.head].key.m_ts < m_windowEnd)
+        {
+            return m_current;
+        }
+        m_current = (m_current + 1) & m_mask;
+        m_windowEnd += m_width;
+    }
+
+    // Sparse queue: jump straight to the earliest event
+    const Event* earliest = nullptr;
+    for (const Bucket& bucket : m_buckets)
+    {
+        if (!bucket.Empty() && (earliest == nullptr || bucket.events[bucket.head].key < earliest->key))
+        {
+            earliest = &bucket.events[bucket.head];
+        }
+    }
+    m_current = BucketOf(earliest->key.m_ts);
+    m_windowEnd = (earliest->key.m_ts / m_width + 1) * m_width;
+    return m_current;
+}
+
+Scheduler::Event
+SlotCalendarScheduler::PeekNext() const
+{
+    NS_LOG_FUNCTION(this);
+    const Bucket& bucket = m_buckets[FindNext()];
+    return bucket.events[bucket.head];
+}
+
+Scheduler::Event
+SlotCalendarScheduler::RemoveNext()
+{
+    NS_LOG_FUNCTION(this);
+    Bucket& bucket = m_buckets[FindNext()];
+    Event ev = bucket.events[bucket.head++];
+    // Drop the removed prefix once it is half of the bucket, so that a
+    // long-lived event (e.g. the stop event) does not keep every event
+    // removed before it; the copy is amortized over those removals
+    if (bucket.Empty())
+    {
+        bucket.events.clear();
+        bucket.head = 0;
+    }
+    else if (2 * bucket.head >= bucket.events.size())
+    {
+        bucket.events.erase(bucket.events.begin(), bucket.events.begin() + bucket.head);
+        bucket.head = 0;
+    }
+    if (--m_size < m_buckets.size() / 4 && m_buckets.size() > MIN_BUCKETS)
+    {
+        Resize(m_buckets.size() / 2);
+    }
+    return ev;
+}
+
+void
+SlotCalendarScheduler::Remove(const Event& ev)
+{
+    NS_LOG_FUNCTION(this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+    Bucket& bucket = m_buckets[BucketOf(ev.key.m_ts)];
+    auto pos = std::lower_bound(bucket.events.begin() + bucket.head,
+                                bucket.events.end(),
+                                ev,
+                                [](const Event& a, const Event& b) { return a.key < b.key; });
+    NS_ASSERT_MSG(pos != bucket.events.end() && pos->key.m_uid == ev.key.m_uid,
+                  "Event to remove is not in the queue");
+    bucket.events.erase(pos);
+    --m_size;
+}
+
+void
+SlotCalendarScheduler::Resize(std::size_t count)
+{
+    NS_LOG_FUNCTION(this << count);
+    std::vector<Bucket> old;
+    old.swap(m_buckets);
+    m_buckets.resize(count);
+    m_mask = count - 1;
+    for (const Bucket& bucket : old)
+    {
+        // A new bucket gathers events from several old ones, so insert in
+        // order rather than append
+        for (std::size_t i = bucket.head; i < bucket.events.size(); ++i)
+        {
+            const Event& ev = bucket.events[i];
+            Bucket& target = m_buckets[BucketOf(ev.key.m_ts)];
+            auto pos = std::upper_bound(target.events.begin(),
+                                        target.events.end(),
+                                        ev,
+                                        [](const Event& a, const Event& b) { return a.key < b.key; });
+            target.events.insert(pos, ev);
+        }
+    }
+    // Keep the cursor on the same window
+    m_current = BucketOf(m_windowEnd - m_width);
+}
+
+} // namespace ns3
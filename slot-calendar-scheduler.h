@@ -0,0 +1,94 @@
+#ifndef SLOT_CALENDAR_SCHEDULER_H
+#define SLOT_CALENDAR_SCHEDULER_H
+
+#include "ns3/nstime.h"
+#include "ns3/scheduler.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Calendar queue scheduler with a fixed bucket width, meant to be
+ * set to the NR symbol duration.
+ *
+ * R. Brown, "Calendar queues: a fast O(1) priority queue implementation
+ * for the simulation event set problem", CACM 31(10), 1988.
+ *
+ * Events are hashed by timestamp into a ring of buckets, each BucketWidth
+ * wide; the next event is found by walking the ring from the current
+ * bucket. With the width set to one OFDM symbol (slot / 14), the slot- and
+ * symbol-periodic events of the NR PHY land a few per bucket, so insert and
+ * remove are O(1) on average and mostly touch adjacent memory, instead of
+ * O(log n) tree or heap operations. The number of buckets follows the queue
+ * size (doubling and halving), while the width stays fixed; a full empty
+ * revolution falls back to a direct search for the earliest event.
+ *
+ * Each bucket keeps its events sorted in a vector, with a read offset for
+ * the events already removed, so that appending later events and taking
+ * the earliest are both cheap. The removed prefix is dropped once it makes
+ * up half of the bucket. Inserting into a bucket is linear in its size, so
+ * with very many events per bucket (e.g. 100 000 pending within a few
+ * slots) HeapScheduler is faster.
+ */
+class SlotCalendarScheduler : public Scheduler
+{
+  public:
+    static TypeId GetTypeId();
+
+    SlotCalendarScheduler();
+    ~SlotCalendarScheduler() override;
+
+    void Insert(const Event& ev) override;
+    bool IsEmpty() const override;
+    Event PeekNext() const override;
+    Event RemoveNext() override;
+    void Remove(const Event& ev) override;
+
+  private:
+    /// Events of one bucket, sorted; those before head are removed
+    struct Bucket
+    {
+        std::vector<Event> events;
+        std::size_t head{0};
+
+        bool Empty() const
+        {
+            return head == events.size();
+        }
+    };
+
+    void SetBucketWidth(Time width);
+    Time GetBucketWidth() const;
+
+    /// Bucket of timestamp \p ts
+    std::size_t BucketOf(uint64_t ts) const;
+
+    /**
+     * Move the cursor to the bucket holding the earliest event.
+     * @return that bucket; the queue must not be empty
+     */
+    std::size_t FindNext() const;
+
+    /// Rehash all events into \p count buckets
+    void Resize(std::size_t count);
+
+    static const std::size_t MIN_BUCKETS = 64;
+
+    uint64_t m_width{1};           ///< bucket width [time steps]
+    std::vector<Bucket> m_buckets; ///< the calendar, a power of two in size
+    std::size_t m_mask{0};         ///< m_buckets.size () - 1
+    std::size_t m_size{0};         ///< number of queued events
+    // FindNext moves the cursor forward to the earliest event, also from
+    // the const PeekNext. An event inserted afterwards may be earlier than
+    // that (e.g. one received by the distributed or realtime simulator after
+    // a peek), so Insert moves the cursor back to it.
+    mutable std::size_t m_current{0}; ///< bucket of the current window
+    mutable uint64_t m_windowEnd{1};  ///< end of the current window [time steps]
+};
+
+} // namespace ns3
+
+#endif // SLOT_CALENDAR_SCHEDULER_H
@@ -0,0 +1,158 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \brief Uniform-grid spatial index of points in the plane.
+ *
+ * Points are hashed into square cells of a fixed size. A nearest-point
+ * query visits the border cells of rings around the query, starting at the
+ * first ring that reaches the box of occupied cells and clipped to it, until
+ * no unvisited cell can hold a closer point. With the cell size close to the
+ * typical spacing of the points (e.g. the inter-site distance), it touches a
+ * handful of points instead of all of them.
+ */
+class SpatialGrid
+{
+  public:
+    /// \param cellSize Side of a cell [m]
+    explicit SpatialGrid(double cellSize)
+        : m_cellSize(cellSize)
+    {
+    }
+
+    /// Add point \p id at (x, y)
+    void Insert(uint32_t id, double x, double y)
+    {
+        int64_t cx = Cell(x);
+        int64_t cy = Cell(y);
+        m_cells[Key(cx, cy)].push_back({id, x, y});
+        if (m_size++ == 0)
+        {
+            m_minX = m_maxX = cx;
+            m_minY = m_maxY = cy;
+        }
+        else
+        {
+            m_minX = std::min(m_minX, cx);
+            m_maxX = std::max(m_maxX, cx);
+            m_minY = std::min(m_minY, cy);
+            m_maxY = std::max(m_maxY, cy);
+        }
+    }
+
+    std::size_t Size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * \return the id of the point closest to (x, y); of equally close
+     * points, the lowest id. The index must not be empty.
+     */
+    uint32_t Nearest(double x, double y) const
+    {
+        const int64_t cx = Cell(x);
+        const int64_t cy = Cell(y);
+        uint32_t best = 0;
+        double bestD2 = std::numeric_limits<double>::infinity();
+        auto visit = [&](int64_t i, int64_t j) {
+            auto it = m_cells.find(Key(i, j));
+            if (it == m_cells.end())
+            {
+                return;
+            }
+            for (const Point& p : it->second)
+            {
+                double d2 = (p.x - x) * (p.x - x) + (p.y - y) * (p.y - y);
+                if (d2 < bestD2 || (d2 == bestD2 && p.id < best))
+                {
+                    bestD2 = d2;
+                    best = p.id;
+                }
+            }
+        };
+        // Rings closer than the occupied box are empty: start at the first
+        // one that touches it
+        const int64_t r0 = std::max({m_minX - cx, cx - m_maxX, m_minY - cy, cy - m_maxY, int64_t(0)});
+        for (int64_t r = r0;; ++r)
+        {
+            // Every point of ring r or beyond is at least r - 1 cells away
+            const double bound = (r - 1) * m_cellSize;
+            if (r > r0 && bestD2 < bound * bound)
+            {
+                break;
+            }
+            // Ring r - 1 already covered every occupied cell
+            if (cx - r < m_minX && cx + r > m_maxX && cy - r < m_minY && cy + r > m_maxY)
+            {
+                break;
+            }
+            // Only the border cells of the ring, clipped to the box: its top
+            // and bottom rows, then the rest of its left and right columns
+            const int64_t iLow = std::max(cx - r, m_minX);
+            const int64_t iHigh = std::min(cx + r, m_maxX);
+            const int64_t jLow = std::max(cy - r + 1, m_minY);
+            const int64_t jHigh = std::min(cy + r - 1, m_maxY);
+            for (int64_t j : {cy - r, cy + r})
+            {
+                if (j >= m_minY && j <= m_maxY)
+                {
+                    for (int64_t i = iLow; i <= iHigh; ++i)
+                    {
+                        visit(i, j);
+                    }
+                }
+                if (r == 0)
+                {
+                    break;
+                }
+            }
+            for (int64_t i : {cx - r, cx + r})
+            {
+                if (r > 0 && i >= m_minX && i <= m_maxX)
+                {
+                    for (int64_t j = jLow; j <= jHigh; ++j)
+                    {
+                        visit(i, j);
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+  private:
+    struct Point
+    {
+        uint32_t id;
+        double x;
+        double y;
+    };
+
+    int64_t Cell(double v) const
+    {
+        return static_cast<int64_t>(std::floor(v / m_cellSize));
+    }
+
+    static uint64_t Key(int64_t cx, int64_t cy)
+    {
+        return static_cast<uint64_t>(cx) << 32 ^ static_cast<uint32_t>(cy);
+    }
+
+    double m_cellSize;
+    std::unordered_map<uint64_t, std::vector<Point>> m_cells;
+    std::size_t m_size{0};
+    int64_t m_minX{0}; ///< bounding box of the occupied cells
+    int64_t m_maxX{0};
+    int64_t m_minY{0};
+    int64_t m_maxY{0};
+};
+
+#endif // SPATIAL_GRID_H
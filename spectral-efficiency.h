@@ -0,0 +1,290 @@
+#ifndef SPECTRAL_EFFICIENCY_H
+#define SPECTRAL_EFFICIENCY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SE_HAVE_AVX2_KERNEL 1
+#endif
+
+/**
+ * \file
+ * Conversion of (linear) SINR samples to spectral efficiency, either with
+ * Shannon's formula or by mapping the SINR to the most efficient entry of a
+ * 3GPP TS 38.214 CQI or MCS table that the link supports.
+ */
+
+/// How SINR is mapped to spectral efficiency
+enum class SeMode
+{
+    SHANNON, ///< log2(1 + SINR), the upper bound
+    CQI1,    ///< TS 38.214 Table 5.2.2.1-2 (CQI, up to 64QAM)
+    CQI2,    ///< TS 38.214 Table 5.2.2.1-3 (CQI, up to 256QAM)
+    MCS1,    ///< TS 38.214 Table 5.1.3.1-1 (MCS, up to 64QAM)
+    MCS2,    ///< TS 38.214 Table 5.1.3.1-2 (MCS, up to 256QAM)
+};
+
+/// Spectral efficiency [bps/Hz] of the entries of TS 38.214 Table 5.2.2.1-2, CQI 1..15
+constexpr double CQI_TABLE1_SE[] = {0.1523, 0.2344, 0.3770, 0.6016, 0.8770, 1.1758, 1.4766, 1.9141,
+                                    2.4063, 2.7305, 3.3223, 3.9023, 4.5234, 5.1152, 5.5547};
+
+/// Spectral efficiency [bps/Hz] of the entries of TS 38.214 Table 5.2.2.1-3, CQI 1..15
+constexpr double CQI_TABLE2_SE[] = {0.1523, 0.3770, 0.8770, 1.4766, 1.9141, 2.4063, 2.7305, 3.3223,
+                                    3.9023, 4.5234, 5.1152, 5.5547, 6.2266, 6.9141, 7.4063};
+
+/// Spectral efficiency [bps/Hz] of TS 38.214 Table 5.1.3.1-1, MCS 0..28
+constexpr double MCS_TABLE1_SE[] = {0.2344, 0.3066, 0.3770, 0.4902, 0.6016, 0.7402, 0.8770, 1.0273,
+                                    1.1758, 1.3262, 1.3281, 1.4766, 1.6953, 1.9141, 2.1602, 2.4063,
+                                    2.5703, 2.5664, 2.7305, 3.0293, 3.3223, 3.6094, 3.9023, 4.2129,
+                                    4.5234, 4.8164, 5.1152, 5.3320, 5.5547};
+
+/// Spectral efficiency [bps/Hz] of TS 38.214 Table 5.1.3.1-2, MCS 0..27
+constexpr double MCS_TABLE2_SE[] = {0.2344, 0.3770, 0.6016, 0.8770, 1.1758, 1.4766, 1.6953,
+                                    1.9141, 2.1602, 2.4063, 2.5703, 2.7305, 3.0293, 3.3223,
+                                    3.6094, 3.9023, 4.2129, 4.5234, 4.8164, 5.1152, 5.3320,
+                                    5.5547, 5.8906, 6.2266, 6.5703, 6.9141, 7.1602, 7.4063};
+
+/**
+ * SINR gap between Shannon capacity and a practical modulation and coding
+ * scheme, -ln(5 BER) / 1.5 at BER 5e-5. This is the gap the nr module's
+ * NrAmc applies in its Shannon error model.
+ */
+constexpr double SE_SNR_GAP = 5.5297;
+
+/**
+ * \brief A CQI or MCS table prepared for SINR lookups.
+ *
+ * Entry i is usable when the linear SINR reaches threshold[i]; index 0 is
+ * "out of range" with zero efficiency, so the number of thresholds met is
+ * directly the index into se[].
+ */
+struct SeTable
+{
+    static const std::size_t MAX_ENTRIES = 32;
+    std::size_t size{0};                 ///< number of table entries
+    double threshold[MAX_ENTRIES]{};     ///< required linear SINR, ascending
+    double se[MAX_ENTRIES + 1]{};        ///< efficiency for 0..size thresholds met
+};
+
+/// Build the lookup table for \p mode (unused for SeMode::SHANNON)
+inline SeTable
+MakeSeTable(SeMode mode)
+{
+    const double* values = nullptr;
+    std::size_t size = 0;
+    switch (mode)
+    {
+    case SeMode::CQI1:
+        values = CQI_TABLE1_SE;
+        size = sizeof(CQI_TABLE1_SE) / sizeof(double);
+        break;
+    case SeMode::CQI2:
+        values = CQI_TABLE2_SE;
+        size = sizeof(CQI_TABLE2_SE) / sizeof(double);
+        break;
+    case SeMode::MCS1:
+        values = MCS_TABLE1_SE;
+        size = sizeof(MCS_TABLE1_SE) / sizeof(double);
+        break;
+    case SeMode::MCS2:
+        values = MCS_TABLE2_SE;
+        size = sizeof(MCS_TABLE2_SE) / sizeof(double);
+        break;
+    case SeMode::SHANNON:
+        break;
+    }
+
+    // The MCS tables are not strictly monotonic (e.g. MCS 16/17 of Table
+    // 1); an entry is only worth selecting if it beats all cheaper ones, so
+    // keep the running maximum.
+    SeTable table;
+    double best = 0.0;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        best = std::max(best, values[i]);
+        table.threshold[i] = SE_SNR_GAP * (std::exp2(best) - 1.0);
+        table.se[i + 1] = best;
+    }
+    table.size = size;
+    return table;
+}
+
+/// Table for \p mode, built on first use
+inline const SeTable&
+GetSeTable(SeMode mode)
+{
+    static const SeTable tables[] = {MakeSeTable(SeMode::SHANNON),
+                                     MakeSeTable(SeMode::CQI1),
+                                     MakeSeTable(SeMode::CQI2),
+                                     MakeSeTable(SeMode::MCS1),
+                                     MakeSeTable(SeMode::MCS2)};
+    return tables[static_cast<int>(mode)];
+}
+
+/**
+ * Parse a mode name as given on the command line.
+ * \return false if \p name is unknown
+ */
+inline bool
+ParseSeMode(const std::string& name, SeMode& mode)
+{
+    static const char* const names[] = {"shannon", "cqi1", "cqi2", "mcs1", "mcs2"};
+    for (int i = 0; i < 5; ++i)
+    {
+        if (name == names[i])
+        {
+            mode = static_cast<SeMode>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Spectral efficiency of one SINR sample.
+ * \param sinr Linear SINR
+ * \param mode Mapping to use
+ * \return spectral efficiency [bps/Hz]
+ */
+inline double
+SpectralEfficiency(double sinr, SeMode mode)
+{
+    if (!(sinr > 0.0))
+    {
+        return 0.0;
+    }
+    if (mode == SeMode::SHANNON)
+    {
+        return std::log2(1.0 + sinr);
+    }
+    const SeTable& table = GetSeTable(mode);
+    std::size_t met = 0;
+    while (met < table.size && sinr >= table.threshold[met])
+    {
+        ++met;
+    }
+    return table.se[met];
+}
+
+/// Scalar kernel, used when AVX2 is not available and for the tail
+inline void
+SpectralEfficiencyScalar(const double* sinr, double* se, std::size_t n, SeMode mode)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        se[i] = SpectralEfficiency(sinr[i], mode);
+    }
+}
+
+#ifdef SE_HAVE_AVX2_KERNEL
+
+/**
+ * log2 of four doubles >= 1. Splits off the exponent, folds the mantissa
+ * into [sqrt(1/2), sqrt(2)) and evaluates the atanh series of ln(m) up to
+ * t^13, which is accurate to about 1e-11.
+ */
+__attribute__((target("avx2,fma"))) inline __m256d
+Log2Avx2(__m256d x)
+{
+    const __m256i bits = _mm256_castpd_si256(x);
+    const __m256i mantissaMask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m256i one = _mm256_castpd_si256(_mm256_set1_pd(1.0));
+
+    // x = 2^e * m, m in [1, 2)
+    __m256i exponentBits = _mm256_sub_epi64(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(1023));
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissaMask), one));
+
+    // int64 -> double for small integers: add the magic 2^52 + 2^51
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+    __m256d e = _mm256_sub_pd(
+        _mm256_castsi256_pd(_mm256_add_epi64(exponentBits, _mm256_castpd_si256(magic))),
+        magic);
+
+    // Fold m into [sqrt(1/2), sqrt(2))
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(1.4142135623730951), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    e = _mm256_add_pd(e, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
+
+    // ln(m) = 2 atanh(t), t = (m - 1) / (m + 1), |t| < 0.172
+    __m256d t = _mm256_div_pd(_mm256_sub_pd(m, _mm256_set1_pd(1.0)),
+                              _mm256_add_pd(m, _mm256_set1_pd(1.0)));
+    __m256d t2 = _mm256_mul_pd(t, t);
+    __m256d p = _mm256_set1_pd(1.0 / 13.0);
+    p = _mm256_fmadd_pd(p, t2, _mm256_set1_pd(1.0 / 11.0));
+    p = _mm256_fmadd_pd(p, t2, _mm256_set1_pd(1.0 / 9.0));
+    p = _mm256_fmadd_pd(p, t2, _mm256_set1_pd(1.0 / 7.0));
+    p = _mm256_fmadd_pd(p, t2, _mm256_set1_pd(1.0 / 5.0));
+    p = _mm256_fmadd_pd(p, t2, _mm256_set1_pd(1.0 / 3.0));
+    p = _mm256_fmadd_pd(p, t2, _mm256_set1_pd(1.0));
+    __m256d lnM = _mm256_mul_pd(_mm256_mul_pd(p, t), _mm256_set1_pd(2.0));
+
+    return _mm256_fmadd_pd(lnM, _mm256_set1_pd(1.4426950408889634), e);
+}
+
+/// AVX2 kernel; n may be any size, the tail is done by the scalar kernel
+__attribute__((target("avx2,fma"))) inline void
+SpectralEfficiencyAvx2(const double* sinr, double* se, std::size_t n, SeMode mode)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    std::size_t i = 0;
+    if (mode == SeMode::SHANNON)
+    {
+        const __m256d one = _mm256_set1_pd(1.0);
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256d s = _mm256_loadu_pd(sinr + i);
+            // Non-positive and NaN samples give 0, as in the scalar kernel
+            __m256d valid = _mm256_cmp_pd(s, zero, _CMP_GT_OQ);
+            s = _mm256_and_pd(s, valid);
+            _mm256_storeu_pd(se + i, Log2Avx2(_mm256_add_pd(one, s)));
+        }
+    }
+    else
+    {
+        const SeTable& table = GetSeTable(mode);
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256d s = _mm256_loadu_pd(sinr + i);
+            // Count the thresholds met; the compare yields -1 per lane
+            __m256i met = _mm256_setzero_si256();
+            for (std::size_t k = 0; k < table.size; ++k)
+            {
+                __m256d ge = _mm256_cmp_pd(s, _mm256_set1_pd(table.threshold[k]), _CMP_GE_OQ);
+                met = _mm256_sub_epi64(met, _mm256_castpd_si256(ge));
+            }
+            _mm256_storeu_pd(se + i, _mm256_i64gather_pd(table.se, met, 8));
+        }
+    }
+    SpectralEfficiencyScalar(sinr + i, se + i, n - i, mode);
+}
+
+#endif // SE_HAVE_AVX2_KERNEL
+
+/**
+ * Spectral efficiency of a batch of SINR samples, using the AVX2 kernel
+ * when the CPU supports it.
+ * \param sinr Linear SINR samples
+ * \param se Output, one spectral efficiency [bps/Hz] per sample
+ * \param n Number of samples
+ * \param mode Mapping to use
+ */
+inline void
+SpectralEfficiencyBatch(const double* sinr, double* se, std::size_t n, SeMode mode)
+{
+#ifdef SE_HAVE_AVX2_KERNEL
+    static const bool haveAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (haveAvx2)
+    {
+        SpectralEfficiencyAvx2(sinr, se, n, mode);
+        return;
+    }
+#endif
+    SpectralEfficiencyScalar(sinr, se, n, mode);
+}
+
+#endif // SPECTRAL_EFFICIENCY_H
@@ -0,0 +1,96 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * \brief Bounded, lock-free single-producer/single-consumer ring buffer.
+ *
+ * One thread may push and one other thread may pop concurrently, without
+ * locks or system calls. The capacity is rounded up to a power of two. Head
+ * and tail live on separate cache lines, and each side keeps a cached copy
+ * of the other side's index, so that the shared indices are only re-read
+ * when the ring looks full (producer) or empty (consumer).
+ */
+template <typename T>
+class SpscRing
+{
+  public:
+    explicit SpscRing(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    std::size_t Capacity() const
+    {
+        return m_slots.size();
+    }
+
+    /// Producer side: \return false if the ring is full
+    bool TryPush(const T& item)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache == m_slots.size())
+        {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache == m_slots.size())
+            {
+                return false;
+            }
+        }
+        m_slots[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side: move up to \p max items to \p out.
+     * \return the number of items popped
+     */
+    std::size_t PopBatch(T* out, std::size_t max)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (m_tailCache == head)
+        {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+        }
+        std::size_t count = m_tailCache - head;
+        if (count > max)
+        {
+            count = max;
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out[i] = m_slots[(head + i) & m_mask];
+        }
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+  private:
+    static const std::size_t CACHE_LINE = 64;
+
+    std::vector<T> m_slots;
+    std::size_t m_mask{0};
+    /// Next slot to pop; written by the consumer
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_head{0};
+    /// Consumer's copy of m_tail
+    std::size_t m_tailCache{0};
+    /// Next slot to push; written by the producer
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_tail{0};
+    /// Producer's copy of m_head
+    std::size_t m_headCache{0};
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,348 @@
+#ifndef TELEMETRY_SHM_H
+#define TELEMETRY_SHM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * \file
+ * Live progress counters of a simulation process, shared by 5Gmain.cc
+ * (writer) and the --monitor mode of Main5G-loop.cpp (reader).
+ *
+ * Each process that runs with --telemetry creates the POSIX shared memory
+ * segment /5gsim-<pid>, i.e. /dev/shm/5gsim-<pid> on Linux, holding one
+ * TelemetryCounters. The simulator is the only writer and updates the
+ * counters with relaxed atomic stores, which cost about as much as a plain
+ * store; readers map the segment read-only and see each counter whole,
+ * though not necessarily all of them from the same instant.
+ */
+
+/// State of the process, in TelemetryCounters::state
+enum TelemetryState : uint64_t
+{
+    TELEMETRY_STARTING = 0, ///< parsing options, loading caches
+    TELEMETRY_BUILDING = 1, ///< building the scenario of a replication
+    TELEMETRY_RUNNING = 2,  ///< in Simulator::Run
+    TELEMETRY_FORKING = 3,  ///< waiting for forked replications, each with its own segment
+    TELEMETRY_DONE = 4,     ///< all replications finished
+};
+
+/// Slots of TelemetryCounters::callbacks, indexed by TraceRecordType
+static const std::size_t TELEMETRY_CALLBACK_SLOTS = 8;
+
+/// Fixed layout of a telemetry segment
+struct TelemetryCounters
+{
+    std::atomic<uint64_t> magic;            ///< TELEMETRY_MAGIC once the fields below are set
+    uint32_t version;                       ///< see TELEMETRY_VERSION
+    uint32_t size;                          ///< sizeof(TelemetryCounters) of the writer
+    int32_t pid;                            ///< the writer
+    int32_t parentPid;                      ///< the process it was forked from, 0 if none
+    uint64_t ticksPerSecond;                ///< simulator time steps per second
+    std::atomic<uint64_t> state;            ///< a TelemetryState
+    std::atomic<uint64_t> run;              ///< RngRun of the current replication
+    std::atomic<uint64_t> replications;     ///< replications of this process
+    std::atomic<uint64_t> replicationsDone; ///< of which finished
+    std::atomic<uint64_t> runStartNs;       ///< CLOCK_MONOTONIC at the start of the run
+    std::atomic<uint64_t> stopTicks;        ///< simulated time the run stops at, at the latest
+    std::atomic<uint64_t> nowTicks;         ///< simulated time of the last event
+    std::atomic<uint64_t> events;           ///< events run in this replication
+    std::atomic<uint64_t> pendingEvents;    ///< events in the queue
+    std::atomic<uint64_t> callbacks[TELEMETRY_CALLBACK_SLOTS]; ///< trace callbacks in this replication
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the counters must be usable from another process");
+
+static const uint64_t TELEMETRY_MAGIC = 0x354754454c454d00ULL; // "5GTELEM\0"
+static const uint32_t TELEMETRY_VERSION = 2;
+static const char TELEMETRY_PREFIX[] = "5gsim-";
+
+/// \return CLOCK_MONOTONIC, which all processes of the host share [ns]
+inline uint64_t
+TelemetryClockNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+/**
+ * \brief The segment of this process, written by the simulator.
+ *
+ * The counter updates do nothing while the segment is not open, so they
+ * can stay in the trace callbacks and the scheduler unconditionally.
+ */
+class TelemetryWriter
+{
+  public:
+    ~TelemetryWriter()
+    {
+        Close();
+    }
+
+    /**
+     * Create the segment of this process.
+     * @param ticksPerSecond Simulator time steps per second
+     * @param replications Replications this process will run
+     * @param parentPid The process this one was forked from, 0 if none
+     * @return false if the segment could not be created.
+     */
+    bool Open(uint64_t ticksPerSecond, uint64_t replications, int32_t parentPid = 0)
+    {
+        Close();
+        m_name = std::string("/") + TELEMETRY_PREFIX + std::to_string(getpid());
+        int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        void* p = MAP_FAILED;
+        if (ftruncate(fd, sizeof(TelemetryCounters)) == 0)
+        {
+            p = mmap(nullptr, sizeof(TelemetryCounters), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            shm_unlink(m_name.c_str());
+            return false;
+        }
+        // The segment starts zeroed, i.e. every counter 0 and state STARTING
+        m_counters = static_cast<TelemetryCounters*>(p);
+        m_counters->version = TELEMETRY_VERSION;
+        m_counters->size = sizeof(TelemetryCounters);
+        m_counters->pid = getpid();
+        m_counters->parentPid = parentPid;
+        m_counters->ticksPerSecond = ticksPerSecond;
+        m_counters->replications.store(replications, std::memory_order_relaxed);
+        // Publishes the fields above to a reader that sees the magic
+        m_counters->magic.store(TELEMETRY_MAGIC, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Give up the segment inherited from the parent, without removing it,
+     * e.g. in a forked child before it opens its own.
+     */
+    void Detach()
+    {
+        if (m_counters)
+        {
+            munmap(m_counters, sizeof(TelemetryCounters));
+            m_counters = nullptr;
+        }
+    }
+
+    /// Remove the segment
+    void Close()
+    {
+        if (m_counters)
+        {
+            Detach();
+            shm_unlink(m_name.c_str());
+        }
+    }
+
+    bool IsOpen() const
+    {
+        return m_counters != nullptr;
+    }
+
+    /// The counters, nullptr while closed
+    TelemetryCounters* Counters()
+    {
+        return m_counters;
+    }
+
+    void SetState(TelemetryState state)
+    {
+        if (m_counters)
+        {
+            m_counters->state.store(state, std::memory_order_relaxed);
+        }
+    }
+
+    /// A replication starts building; clears the counters of the previous one
+    void BeginReplication(uint64_t run)
+    {
+        if (!m_counters)
+        {
+            return;
+        }
+        m_counters->run.store(run, std::memory_order_relaxed);
+        m_counters->nowTicks.store(0, std::memory_order_relaxed);
+        m_counters->events.store(0, std::memory_order_relaxed);
+        m_counters->pendingEvents.store(0, std::memory_order_relaxed);
+        for (auto& count : m_counters->callbacks)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        m_counters->state.store(TELEMETRY_BUILDING, std::memory_order_relaxed);
+    }
+
+    /// The replication enters Simulator::Run, to stop at \p stopTicks at the latest
+    void BeginRun(uint64_t stopTicks)
+    {
+        if (m_counters)
+        {
+            m_counters->stopTicks.store(stopTicks, std::memory_order_relaxed);
+            m_counters->runStartNs.store(TelemetryClockNs(), std::memory_order_relaxed);
+            m_counters->state.store(TELEMETRY_RUNNING, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * The replication left Simulator::Run: the counters keep its final
+     * values, and the state is BUILDING until the next one starts, or DONE
+     * after the last one.
+     */
+    void EndRun()
+    {
+        if (m_counters)
+        {
+            EndReplication();
+            bool last = m_counters->replicationsDone.load(std::memory_order_relaxed) >=
+                        m_counters->replications.load(std::memory_order_relaxed);
+            m_counters->state.store(last ? TELEMETRY_DONE : TELEMETRY_BUILDING,
+                                    std::memory_order_relaxed);
+        }
+    }
+
+    /// A replication of this process, or of one forked from it, finished
+    void EndReplication()
+    {
+        if (m_counters)
+        {
+            Increment(m_counters->replicationsDone);
+        }
+    }
+
+    /// Count a trace callback of type \p type (a TraceRecordType)
+    void CountCallback(uint16_t type)
+    {
+        if (m_counters && type < TELEMETRY_CALLBACK_SLOTS)
+        {
+            Increment(m_counters->callbacks[type]);
+        }
+    }
+
+    /// Single-writer increment: a load and a store, no locked instruction
+    static void Increment(std::atomic<uint64_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+  private:
+    TelemetryCounters* m_counters{nullptr};
+    std::string m_name;
+};
+
+/**
+ * \brief Read-only mapping of the segment of another process.
+ */
+class TelemetryReader
+{
+  public:
+    TelemetryReader() = default;
+
+    ~TelemetryReader()
+    {
+        if (m_counters)
+        {
+            munmap(const_cast<TelemetryCounters*>(m_counters), sizeof(TelemetryCounters));
+        }
+    }
+
+    TelemetryReader(const TelemetryReader&) = delete;
+    TelemetryReader& operator=(const TelemetryReader&) = delete;
+
+    /**
+     * Map segment \p name, e.g. "5gsim-1234".
+     * @return false if it does not exist (any more), is still being
+     * created, or has another layout.
+     */
+    bool Open(const std::string& name)
+    {
+        int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+        void* p = mmap(nullptr, sizeof(TelemetryCounters), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            return false;
+        }
+        m_counters = static_cast<const TelemetryCounters*>(p);
+        // The fields the writer set before the magic are visible once it is
+        if (m_counters->magic.load(std::memory_order_acquire) != TELEMETRY_MAGIC ||
+            m_counters->version != TELEMETRY_VERSION ||
+            m_counters->size != sizeof(TelemetryCounters))
+        {
+            munmap(p, sizeof(TelemetryCounters));
+            m_counters = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    const TelemetryCounters& Counters() const
+    {
+        return *m_counters;
+    }
+
+    /// \return whether the writer still runs
+    bool WriterAlive() const
+    {
+        return kill(m_counters->pid, 0) == 0 || errno == EPERM;
+    }
+
+    /// \return the names of all telemetry segments, by pid
+    static std::vector<std::string> List()
+    {
+        std::vector<std::string> names;
+        DIR* dir = opendir("/dev/shm");
+        if (!dir)
+        {
+            return names;
+        }
+        const std::size_t prefixLength = sizeof(TELEMETRY_PREFIX) - 1;
+        while (struct dirent* entry = readdir(dir))
+        {
+            if (std::strncmp(entry->d_name, TELEMETRY_PREFIX, prefixLength) == 0)
+            {
+                names.push_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) {
+            return a.size() != b.size() ? a.size() < b.size() : a < b;
+        });
+        return names;
+    }
+
+    /// Remove segment \p name, e.g. that of a process that died
+    static void Remove(const std::string& name)
+    {
+        shm_unlink(("/" + name).c_str());
+    }
+
+  private:
+    const TelemetryCounters* m_counters{nullptr};
+};
+
+#endif // TELEMETRY_SHM_H
@@ -0,0 +1,299 @@
+#ifndef TRACE_RECORD_H
+#define TRACE_RECORD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * \file
+ * Binary trace format shared by 5Gmain.cc (producer) and Main5G-loop.cpp
+ * (consumer).
+ *
+ * A trace file is a TraceFileHeader, followed by headerFieldCount
+ * TraceFieldDesc entries describing the layout of TraceRecord, padding up
+ * to TraceFileHeader::headerSize, and then a flat array of fixed-width
+ * TraceRecord entries in native byte order. Readers check the record size
+ * and version instead of parsing anything, so the records can be used in
+ * place from a memory mapping.
+ */
+
+/// Kind of event stored in a TraceRecord
+enum TraceRecordType : uint16_t
+{
+    TRACE_SINR = 1,     ///< DlDataSinr: value[0] SINR (linear), value[1] SE [bps/Hz]
+    TRACE_RSSI = 2,     ///< RssiPerProcessedChunk: value[0] RSSI [dBm]
+    TRACE_RLC_RX = 3,   ///< RLC RxPDU: aux bytes, bwpId lcid, value[0] delay [ns]
+    TRACE_PDCP_RX = 4,  ///< PDCP RxPDU: aux bytes, bwpId lcid, value[0] delay [ns]
+    TRACE_POSITION = 5, ///< UE position: aux node id, value[0..2] x, y, z [m]
+};
+
+/// One traced event; 48 bytes, naturally aligned
+struct TraceRecord
+{
+    int64_t timeNs;  ///< simulation time of the event [ns]
+    uint32_t run;    ///< RngRun of the replication that produced it
+    uint16_t type;   ///< a TraceRecordType
+    uint16_t cellId; ///< cell id, 0 if unknown
+    uint16_t rnti;   ///< RNTI, 0 if unknown
+    uint16_t bwpId;  ///< BWP id, or logical channel id for RLC/PDCP records
+    uint32_t aux;    ///< type dependent integer (bytes, node id)
+    double value[3]; ///< type dependent values
+};
+
+static_assert(sizeof(TraceRecord) == 48, "TraceRecord must stay fixed-width");
+
+/// Start of every trace file
+struct TraceFileHeader
+{
+    char magic[8];       ///< "5GTRACE" followed by a NUL
+    uint32_t version;    ///< format version, see TRACE_FORMAT_VERSION
+    uint32_t headerSize; ///< offset of the first record, multiple of 8
+    uint32_t recordSize; ///< sizeof(TraceRecord) of the producer
+    uint32_t fieldCount; ///< number of TraceFieldDesc entries that follow
+};
+
+/// Description of one TraceRecord field, so that other tools can decode
+/// the records without this header
+struct TraceFieldDesc
+{
+    char name[24];   ///< field name, NUL terminated
+    uint32_t offset; ///< byte offset in the record
+    uint16_t size;   ///< size of one element in bytes
+    uint16_t kind;   ///< 0 signed integer, 1 unsigned integer, 2 IEEE float
+};
+
+static const char TRACE_MAGIC[8] = {'5', 'G', 'T', 'R', 'A', 'C', 'E', '\0'};
+static const uint32_t TRACE_FORMAT_VERSION = 1;
+
+/// Schema written into the header of every trace file
+inline std::vector<TraceFieldDesc>
+TraceRecordSchema()
+{
+    return {
+        {"timeNs", offsetof(TraceRecord, timeNs), 8, 0},
+        {"run", offsetof(TraceRecord, run), 4, 1},
+        {"type", offsetof(TraceRecord, type), 2, 1},
+        {"cellId", offsetof(TraceRecord, cellId), 2, 1},
+        {"rnti", offsetof(TraceRecord, rnti), 2, 1},
+        {"bwpId", offsetof(TraceRecord, bwpId), 2, 1},
+        {"aux", offsetof(TraceRecord, aux), 4, 1},
+        {"value0", offsetof(TraceRecord, value), 8, 2},
+        {"value1", offsetof(TraceRecord, value) + 8, 8, 2},
+        {"value2", offsetof(TraceRecord, value) + 16, 8, 2},
+    };
+}
+
+/**
+ * \brief Buffered writer of a binary trace file.
+ *
+ * Records are copied into a preallocated buffer and written out with one
+ * write() per full buffer, so appending a record costs a memcpy.
+ */
+class TraceFileWriter
+{
+  public:
+    explicit TraceFileWriter(std::size_t bufferRecords = 8192)
+        : m_buffer(bufferRecords)
+    {
+    }
+
+    ~TraceFileWriter()
+    {
+        Close();
+    }
+
+    TraceFileWriter(const TraceFileWriter&) = delete;
+    TraceFileWriter& operator=(const TraceFileWriter&) = delete;
+
+    /**
+     * Create (or truncate) \p path and write the header.
+     * @return false if the file could not be created.
+     */
+    bool Open(const std::string& path)
+    {
+        Close();
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (m_fd < 0)
+        {
+            return false;
+        }
+        std::vector<TraceFieldDesc> schema = TraceRecordSchema();
+        TraceFileHeader header;
+        std::memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.version = TRACE_FORMAT_VERSION;
+        header.recordSize = sizeof(TraceRecord);
+        header.fieldCount = static_cast<uint32_t>(schema.size());
+        std::size_t size = sizeof(header) + schema.size() * sizeof(TraceFieldDesc);
+        header.headerSize = static_cast<uint32_t>((size + 7) & ~std::size_t(7));
+
+        std::vector<char> bytes(header.headerSize, 0);
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        std::memcpy(bytes.data() + sizeof(header),
+                    schema.data(),
+                    schema.size() * sizeof(TraceFieldDesc));
+        return WriteAll(bytes.data(), bytes.size());
+    }
+
+    bool IsOpen() const
+    {
+        return m_fd >= 0;
+    }
+
+    /// Queue one record; flushes when the buffer is full
+    void Append(const TraceRecord& record)
+    {
+        m_buffer[m_used++] = record;
+        if (m_used == m_buffer.size())
+        {
+            Flush();
+        }
+    }
+
+    /// Write all queued records to the file
+    void Flush()
+    {
+        if (m_fd >= 0 && m_used > 0)
+        {
+            WriteAll(m_buffer.data(), m_used * sizeof(TraceRecord));
+        }
+        m_used = 0;
+    }
+
+    void Close()
+    {
+        if (m_fd >= 0)
+        {
+            Flush();
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+  private:
+    bool WriteAll(const void* data, std::size_t size)
+    {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            ssize_t n = ::write(m_fd, p, size);
+            if (n <= 0)
+            {
+                return false;
+            }
+            p += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    int m_fd{-1};
+    std::vector<TraceRecord> m_buffer;
+    std::size_t m_used{0};
+};
+
+/**
+ * \brief Read-only, zero-copy view of a binary trace file.
+ *
+ * The file is mapped into memory and the records are handed out as a
+ * pointer range into the mapping; nothing is copied or parsed.
+ */
+class TraceFileView
+{
+  public:
+    TraceFileView() = default;
+
+    ~TraceFileView()
+    {
+        Close();
+    }
+
+    TraceFileView(const TraceFileView&) = delete;
+    TraceFileView& operator=(const TraceFileView&) = delete;
+
+    /**
+     * Map \p path and validate its header.
+     * @return false if the file is missing or not a compatible trace.
+     */
+    bool Open(const std::string& path)
+    {
+        Close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(TraceFileHeader)))
+        {
+            ::close(fd);
+            return false;
+        }
+        m_size = static_cast<std::size_t>(st.st_size);
+        void* map = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            m_size = 0;
+            return false;
+        }
+        m_map = static_cast<const char*>(map);
+        madvise(map, m_size, MADV_SEQUENTIAL);
+
+        const TraceFileHeader* header = reinterpret_cast<const TraceFileHeader*>(m_map);
+        if (std::memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+            header->version != TRACE_FORMAT_VERSION || header->recordSize != sizeof(TraceRecord) ||
+            header->headerSize % 8 != 0 || header->headerSize > m_size)
+        {
+            Close();
+            return false;
+        }
+        m_begin = reinterpret_cast<const TraceRecord*>(m_map + header->headerSize);
+        // A truncated trailing record (e.g. from a crashed producer) is ignored
+        m_count = (m_size - header->headerSize) / sizeof(TraceRecord);
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_map != nullptr)
+        {
+            munmap(const_cast<char*>(m_map), m_size);
+        }
+        m_map = nullptr;
+        m_size = 0;
+        m_begin = nullptr;
+        m_count = 0;
+    }
+
+    const TraceRecord* begin() const
+    {
+        return m_begin;
+    }
+
+    const TraceRecord* end() const
+    {
+        return m_begin + m_count;
+    }
+
+    std::size_t size() const
+    {
+        return m_count;
+    }
+
+  private:
+    const char* m_map{nullptr};
+    std::size_t m_size{0};
+    const TraceRecord* m_begin{nullptr};
+    std::size_t m_count{0};
+};
+
+#endif // TRACE_RECORD_H
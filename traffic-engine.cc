@@ -0,0 +1,235 @@
+#include "traffic-engine.h"
+
+#include "philox-rng.h"
+
+#include "ns3/eps-bearer-tag.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/log.h"
+#include "ns3/lte-ue-rrc.h"
+#include "ns3/nr-ue-net-device.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+#include "ns3/udp-l4-protocol.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("TrafficEngine");
+
+bool
+TrafficEngine::ParseModel(const std::string& name, Model& model)
+{
+    if (name == "none")
+    {
+        model = NONE;
+    }
+    else if (name == "cbr")
+    {
+        model = CBR;
+    }
+    else if (name == "poisson")
+    {
+        model = POISSON;
+    }
+    else if (name == "full")
+    {
+        model = FULL_BUFFER;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void
+TrafficEngine::Configure(const Config& config)
+{
+    m_config = config;
+    m_flows.clear();
+    m_flowOf.clear();
+}
+
+void
+TrafficEngine::AddFlow(Ptr<NetDevice> ue, Ptr<NetDevice> gnb, uint32_t index)
+{
+    Flow flow;
+    flow.ue = ue;
+    flow.gnb = gnb;
+    flow.index = index;
+    m_flows.push_back(flow);
+}
+
+void
+TrafficEngine::Start(Time at)
+{
+    if (m_config.model == NONE || m_flows.empty())
+    {
+        return;
+    }
+    Simulator::Schedule(at, &TrafficEngine::Begin, this);
+}
+
+void
+TrafficEngine::Begin()
+{
+    m_start = Simulator::Now();
+    // Read here rather than at Start, in case the built scenario was
+    // re-seeded in between
+    m_seed = RngSeedManager::GetSeed();
+    m_run = RngSeedManager::GetRun();
+    for (std::size_t i = 0; i < m_flows.size(); ++i)
+    {
+        Flow& flow = m_flows[i];
+        Ptr<LteUeRrc> rrc = DynamicCast<NrUeNetDevice>(flow.ue)->GetRrc();
+        flow.cellId = rrc->GetCellId();
+        flow.rnti = rrc->GetRnti();
+        if (flow.rnti == 0)
+        {
+            NS_LOG_WARN("UE " << flow.index << " is not connected, no traffic");
+            continue;
+        }
+        m_flowOf[static_cast<uint32_t>(flow.cellId) << 16 | flow.rnti] = i;
+
+        // The headers and tags of every packet of the flow, built once
+        flow.packet = Create<Packet>(m_config.packetSize);
+        Ipv4Header ipv4Header;
+        ipv4Header.SetProtocol(UdpL4Protocol::PROT_NUMBER);
+        flow.packet->AddHeader(ipv4Header);
+        EpsBearerTag tag(flow.rnti, 1);
+        flow.packet->AddPacketTag(tag);
+        flow.sender = m_config.uplink ? flow.ue : flow.gnb;
+        flow.destination = m_config.uplink ? flow.gnb->GetAddress() : flow.ue->GetAddress();
+
+        if (m_config.model == POISSON)
+        {
+            ScheduleBurst(i);
+        }
+    }
+    if (m_config.model == CBR || m_config.model == FULL_BUFFER)
+    {
+        Slot();
+    }
+}
+
+void
+TrafficEngine::Slot()
+{
+    const double slotBytes = m_config.rateBps / 8.0 * m_config.slot.GetSeconds();
+    const uint64_t backlogPackets =
+        std::max<uint64_t>(1, m_config.backlogBytes / std::max(1u, m_config.packetSize));
+    const Time now = Simulator::Now();
+    for (Flow& flow : m_flows)
+    {
+        if (!flow.packet)
+        {
+            continue;
+        }
+        if (m_config.model == CBR)
+        {
+            flow.credit += slotBytes;
+            uint64_t packets = static_cast<uint64_t>(flow.credit / flow.packet->GetSize());
+            flow.credit -= static_cast<double>(packets) * flow.packet->GetSize();
+            Send(flow, packets);
+        }
+        else
+        {
+            // Each PDCP PDU received is one packet of the flow, and the
+            // packets sent more than LossTimeout ago are received or lost
+            while (!flow.sends.empty() && flow.sends.front().first + m_config.lossTimeout <= now)
+            {
+                flow.settledTx = flow.sends.front().second;
+                flow.sends.pop_front();
+            }
+            uint64_t settled = std::min(flow.txPackets, std::max(flow.rxPackets, flow.settledTx));
+            uint64_t inFlight = flow.txPackets - settled;
+            if (inFlight < backlogPackets)
+            {
+                Send(flow, backlogPackets - inFlight);
+                flow.sends.emplace_back(now, flow.txPackets);
+            }
+        }
+    }
+    Simulator::Schedule(m_config.slot, &TrafficEngine::Slot, this);
+}
+
+void
+TrafficEngine::ScheduleBurst(std::size_t flow)
+{
+    // Exponential gaps of mean BurstBytes at the flow rate
+    const double meanGap = m_config.burstBytes * 8.0 / m_config.rateBps;
+    PhiloxRng rng(m_seed, m_run, PHILOX_STREAM_TRAFFIC);
+    double u = rng.Uniform(m_flows[flow].index, m_flows[flow].bursts);
+    Simulator::Schedule(Seconds(-std::log1p(-u) * meanGap), &TrafficEngine::Burst, this, flow);
+}
+
+void
+TrafficEngine::Burst(std::size_t flow)
+{
+    Flow& f = m_flows[flow];
+    Send(f, (m_config.burstBytes + m_config.packetSize - 1) / m_config.packetSize);
+    ++f.bursts;
+    ScheduleBurst(flow);
+}
+
+void
+TrafficEngine::Send(Flow& flow, uint64_t packets)
+{
+    for (uint64_t i = 0; i < packets; ++i)
+    {
+        flow.sender->Send(flow.packet->Copy(), flow.destination, Ipv4L3Protocol::PROT_NUMBER);
+    }
+    flow.txPackets += packets;
+    flow.txBytes += packets * flow.packet->GetSize();
+}
+
+void
+TrafficEngine::Received(uint16_t cellId, uint16_t rnti, uint32_t bytes, uint64_t delayNs)
+{
+    auto it = m_flowOf.find(static_cast<uint32_t>(cellId) << 16 | rnti);
+    if (it == m_flowOf.end())
+    {
+        return;
+    }
+    Flow& flow = m_flows[it->second];
+    ++flow.rxPackets;
+    flow.rxBytes += bytes;
+    flow.delayMs.Add(delayNs / 1e6);
+}
+
+void
+TrafficEngine::Report(std::ostream& os, uint64_t run)
+{
+    const double seconds = (Simulator::Now() - m_start).GetSeconds();
+    uint64_t rxBytes = 0;
+    uint32_t flows = 0;
+    for (const Flow& flow : m_flows)
+    {
+        if (!flow.packet || seconds <= 0)
+        {
+            continue;
+        }
+        os << "TRAFFIC run=" << run << " ue=" << flow.index << " cell=" << flow.cellId
+           << " rnti=" << flow.rnti << " tx_bytes=" << flow.txBytes
+           << " rx_bytes=" << flow.rxBytes
+           << " throughput_mbps=" << flow.rxBytes * 8.0 / seconds / 1e6
+           << " delay_mean_ms=" << flow.delayMs.Stats().Mean()
+           << " delay_p50_ms=" << flow.delayMs.P50() << " delay_p99_ms=" << flow.delayMs.P99()
+           << std::endl;
+        rxBytes += flow.rxBytes;
+        ++flows;
+    }
+    if (flows > 0)
+    {
+        os << "TRAFFIC run=" << run << " flows=" << flows
+           << " throughput_mbps=" << rxBytes * 8.0 / seconds / 1e6 << std::endl;
+    }
+    m_flows.clear();
+    m_flowOf.clear();
+}
+
+} // namespace ns3
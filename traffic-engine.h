@@ -0,0 +1,155 @@
+#ifndef TRAFFIC_ENGINE_H
+#define TRAFFIC_ENGINE_H
+
+#include "online-stats.h"
+
+#include "ns3/net-device.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief DL or UL traffic of many UEs at a few events per slot.
+ *
+ * Each flow builds its packet once, with the IPv4 header and the EPS
+ * bearer tag, when the traffic starts; every send is then a Packet::Copy
+ * of it, which shares the buffer and the tags instead of allocating and
+ * serializing them again. The packets go straight to the NR device, as
+ * with the single test packet.
+ *
+ * The constant rate and full-buffer flows are served by one event per
+ * slot for all of them, and each Poisson flow by one event per burst.
+ * Full-buffer flows keep their bytes in flight, i.e. sent but not yet
+ * received at PDCP, topped up to a backlog each slot, so the scheduler
+ * always has data without the RLC buffer dropping most of it. RLC UM does
+ * not retransmit what HARQ fails to deliver, so a packet still not
+ * received after LossTimeout is taken as lost rather than in flight, and
+ * the losses of cell-edge UEs do not stop their flows.
+ *
+ * NotifyRx takes the PDCP receptions of every UE; Report prints the
+ * throughput and PDCP delay of each flow.
+ */
+class TrafficEngine
+{
+  public:
+    /// Traffic of each flow
+    enum Model
+    {
+        NONE,        ///< no flows, only the single test packet
+        CBR,         ///< constant bit rate, packets sent in the slot they are due
+        POISSON,     ///< bursts of BurstBytes at exponential intervals
+        FULL_BUFFER, ///< as much as the scheduler takes
+    };
+
+    /// Parameters of all flows
+    struct Config
+    {
+        Model model = NONE;
+        bool uplink = false;
+        uint32_t packetSize = 1000;  ///< IP payload [bytes]
+        double rateBps = 100e6;      ///< CBR rate, or mean Poisson rate [bit/s]
+        uint32_t burstBytes = 100000; ///< Poisson burst size [bytes]
+        uint32_t backlogBytes = 0;   ///< bytes in flight of a full-buffer flow
+        Time lossTimeout;            ///< full buffer: delay after which a packet is lost
+        Time slot;                   ///< slot period
+    };
+
+    /**
+     * \param name none, cbr, poisson or full
+     * \param model Set to the model
+     * \return false on an unknown name
+     */
+    static bool ParseModel(const std::string& name, Model& model);
+
+    /// Drop the flows of the previous replication and set the parameters
+    void Configure(const Config& config);
+
+    bool IsEnabled() const
+    {
+        return m_config.model != NONE;
+    }
+
+    /**
+     * Add the flow of one UE. Its packet is built at Start, once the UE is
+     * connected and has its RNTI.
+     * \param ue The UE device
+     * \param gnb The gNB device it is attached to
+     * \param index Index of the UE in the scenario, which keys its random
+     * numbers
+     */
+    void AddFlow(Ptr<NetDevice> ue, Ptr<NetDevice> gnb, uint32_t index);
+
+    /**
+     * Start the flows at \p at. The Poisson bursts take the seed and run
+     * current at that time.
+     */
+    void Start(Time at);
+
+    /// Count a PDCP PDU received by the UE (DL) or gNB (UL) of a flow
+    void NotifyRx(uint16_t cellId, uint16_t rnti, uint32_t bytes, uint64_t delayNs)
+    {
+        if (m_config.model != NONE)
+        {
+            Received(cellId, rnti, bytes, delayNs);
+        }
+    }
+
+    /**
+     * Print one TRAFFIC line per flow, with the throughput since the
+     * traffic started, and one with the total, then release the flows.
+     * Called when the simulator is destroyed.
+     * \param os Output stream
+     * \param run Run of the replication
+     */
+    void Report(std::ostream& os, uint64_t run);
+
+  private:
+    struct Flow
+    {
+        Ptr<NetDevice> ue;
+        Ptr<NetDevice> gnb;
+        uint32_t index{0};
+        Ptr<NetDevice> sender;
+        Address destination;
+        Ptr<Packet> packet; ///< template, copied for each send
+        uint16_t cellId{0};
+        uint16_t rnti{0};
+        double credit{0.0}; ///< CBR bytes due but not yet sent
+        uint32_t bursts{0}; ///< Poisson bursts so far
+        uint64_t txBytes{0};
+        uint64_t txPackets{0};
+        uint64_t rxPackets{0};
+        uint64_t rxBytes{0};
+        StreamSummary delayMs; ///< PDCP delay [ms]
+        /// Full buffer: (time, txPackets after it) of the sends within LossTimeout
+        std::deque<std::pair<Time, uint64_t>> sends;
+        uint64_t settledTx{0}; ///< txPackets as of LossTimeout ago
+    };
+
+    void Begin();
+    void Slot();
+    void Burst(std::size_t flow);
+    void ScheduleBurst(std::size_t flow);
+    void Send(Flow& flow, uint64_t packets);
+    void Received(uint16_t cellId, uint16_t rnti, uint32_t bytes, uint64_t delayNs);
+
+    Config m_config;
+    std::vector<Flow> m_flows;
+    std::map<uint32_t, std::size_t> m_flowOf; ///< flow by cellId << 16 | rnti
+    Time m_start;
+    uint32_t m_seed{0};
+    uint64_t m_run{0};
+};
+
+} // namespace ns3
+
+#endif // TRAFFIC_ENGINE_H
@@ -0,0 +1,181 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * \brief One shell command run by RunWorkerPool, together with what it
+ * produced.
+ */
+struct WorkerJob
+{
+    std::string command;    ///< command line, run through /bin/sh -c
+    std::string partial;    ///< stdout after the last complete line so far
+    int status{-1};         ///< exit status, or -1 if it could not be started
+    long maxRssKb{0};       ///< peak RSS of the command and its children [KiB]
+    double cpuSeconds{0.0}; ///< user + system CPU time of the command and its children
+};
+
+/**
+ * Run \p jobs with at most \p maxWorkers child processes alive at a time.
+ * Jobs are started in index order; their stdout is read concurrently so
+ * that a chatty worker never blocks on a full pipe, and handed to \p onLine
+ * line by line as it arrives, so only the line being read is kept: the
+ * caller parses what it needs and the rest is dropped. Since jobs finish in
+ * arbitrary order, \p onLine and \p onDone get the index of the job, and
+ * callers store results by index to stay independent of completion order.
+ * @param jobs The jobs to run; status and usage are filled in.
+ * @param maxWorkers Upper bound on concurrent child processes.
+ * @param onLine Called in the parent for each line a job writes, without
+ * the newline.
+ * @param onDone Called in the parent after each job has exited, after its
+ * last line.
+ */
+inline void
+RunWorkerPool(std::vector<WorkerJob>& jobs,
+              unsigned maxWorkers,
+              const std::function<void(std::size_t, const std::string&)>& onLine,
+              const std::function<void(std::size_t)>& onDone)
+{
+    struct Active
+    {
+        std::size_t job;
+        pid_t pid;
+        int fd;
+    };
+
+    std::vector<Active> active;
+    std::size_t next = 0;
+    if (maxWorkers == 0)
+    {
+        maxWorkers = 1;
+    }
+
+    while (next < jobs.size() || !active.empty())
+    {
+        while (next < jobs.size() && active.size() < maxWorkers)
+        {
+            WorkerJob& job = jobs[next];
+            int fds[2];
+            if (pipe(fds) != 0)
+            {
+                job.status = -1;
+                onDone(next++);
+                continue;
+            }
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                dup2(fds[1], STDOUT_FILENO);
+                close(fds[0]);
+                close(fds[1]);
+                execl("/bin/sh", "sh", "-c", job.command.c_str(), static_cast<char*>(nullptr));
+                _exit(127);
+            }
+            close(fds[1]);
+            if (pid < 0)
+            {
+                close(fds[0]);
+                job.status = -1;
+                onDone(next++);
+                continue;
+            }
+            active.push_back({next++, pid, fds[0]});
+        }
+
+        std::vector<pollfd> fds(active.size());
+        for (std::size_t i = 0; i < active.size(); ++i)
+        {
+            fds[i].fd = active[i].fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // Cannot wait for output any more: stop the workers rather than
+            // leave them behind, and fail every job not finished yet
+            for (const Active& a : active)
+            {
+                kill(a.pid, SIGKILL);
+                close(a.fd);
+                while (waitpid(a.pid, nullptr, 0) < 0 && errno == EINTR)
+                {
+                }
+                jobs[a.job].status = -1;
+                jobs[a.job].partial.clear();
+                onDone(a.job);
+            }
+            for (; next < jobs.size(); ++next)
+            {
+                jobs[next].status = -1;
+                onDone(next);
+            }
+            return;
+        }
+
+        char buffer[65536];
+        for (std::size_t i = active.size(); i-- > 0;)
+        {
+            if (fds[i].revents == 0)
+            {
+                continue;
+            }
+            ssize_t n = read(active[i].fd, buffer, sizeof(buffer));
+            if (n > 0)
+            {
+                std::string& partial = jobs[active[i].job].partial;
+                partial.append(buffer, static_cast<std::size_t>(n));
+                std::size_t begin = 0;
+                for (std::size_t end; (end = partial.find('\n', begin)) != std::string::npos; begin = end + 1)
+                {
+                    onLine(active[i].job, partial.substr(begin, end - begin));
+                }
+                partial.erase(0, begin);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            // EOF (or a read error): reap the worker
+            close(active[i].fd);
+            std::string& partial = jobs[active[i].job].partial;
+            if (!partial.empty())
+            {
+                onLine(active[i].job, partial);
+                partial.clear();
+            }
+            int status = 0;
+            struct rusage usage = {};
+            while (wait4(active[i].pid, &status, 0, &usage) < 0 && errno == EINTR)
+            {
+            }
+            WorkerJob& job = jobs[active[i].job];
+            job.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            job.maxRssKb = usage.ru_maxrss;
+            job.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                             1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+            std::size_t done = active[i].job;
+            active.erase(active.begin() + i);
+            onDone(done);
+        }
+    }
+}
+
+#endif // WORKER_POOL_H